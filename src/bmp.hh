@@ -63,6 +63,8 @@ struct bmp_t {
     // a row
     auto *row(int y) noexcept { return m_buf.data() + y * m_row_stride; }
 
+    [[nodiscard]] auto pxs() const noexcept { return m_pxs; }
+
     [[nodiscard]] auto dims() const { return std::make_tuple(m_w, m_h); }
 
 private:
@@ -0,0 +1,87 @@
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// bounded queue between pipeline stages: push blocks while full, pop blocks while empty, and once every
+// producer is done pop drains what is left and then returns nothing - no timeouts, no flags to poll
+template <typename T>
+class bqueue_t {
+public:
+    explicit bqueue_t(size_t cap): cap{cap} {}
+
+    bqueue_t(const bqueue_t &) = delete;
+    bqueue_t &operator=(const bqueue_t &) = delete;
+
+    // how many done() calls close the queue, set before the producers start
+    void producers(int n) {
+        std::lock_guard lock{mtx};
+        open = n;
+        closed = n <= 0;
+    }
+
+    // false if the queue got closed while waiting, the value is dropped then
+    bool push(T v) {
+        std::unique_lock lock{mtx};
+        not_full.wait(lock, [this] { return closed || items.size() < cap; });
+        if (closed) return false;
+        items.push_back(std::move(v));
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    std::optional<T> pop() {
+        std::unique_lock lock{mtx};
+        not_empty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return {};
+        std::optional<T> ret{std::move(items.front())};
+        items.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return ret;
+    }
+
+    // pop without waiting, nothing if the queue is empty right now - drained() tells if it's for good
+    std::optional<T> try_pop() {
+        std::unique_lock lock{mtx};
+        if (items.empty()) return {};
+        std::optional<T> ret{std::move(items.front())};
+        items.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return ret;
+    }
+
+    // a producer finished, the last one closes the queue
+    void done() {
+        std::unique_lock lock{mtx};
+        if (--open > 0) return;
+        closed = true;
+        lock.unlock();
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+    [[nodiscard]] bool drained() const {
+        std::lock_guard lock{mtx};
+        return closed && items.empty();
+    }
+
+    [[nodiscard]] size_t size() const {
+        std::lock_guard lock{mtx};
+        return items.size();
+    }
+
+private:
+    const size_t cap;
+    mutable std::mutex mtx;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<T> items;
+    int open{1};
+    bool closed{};
+};
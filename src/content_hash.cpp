@@ -0,0 +1,176 @@
+
+#include "content_hash.hh"
+
+#include "xxh64.hh"
+
+#include <gvs_defer.hh>
+#include <gvs_exception.hh>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::array<const char *, 2> names{"sha256", "xxh64"};
+constexpr std::array<uint8_t, 2> sizes{32, 8};
+
+int unhex(char c) noexcept {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// one algorithm's running state, fed the file as it's read
+class hasher_t {
+public:
+    explicit hasher_t(hash_algo_t algo): m_algo{algo} {
+        if (m_algo != hash_algo_t::sha256) return;
+        m_sha.reset(EVP_MD_CTX_new());
+        if (!m_sha || !EVP_DigestInit_ex(m_sha.get(), EVP_sha256(), nullptr)) throw gvs::exception{"sha256 init failed"};
+    }
+
+    void update(const uint8_t *data, size_t size) {
+        if (m_algo == hash_algo_t::xxh64) m_xxh.update(data, size);
+        else if (!EVP_DigestUpdate(m_sha.get(), data, size)) throw gvs::exception{"sha256 update failed"};
+    }
+
+    std::string finish() {
+        hash_digest_t ret{m_algo, sizes[size_t(m_algo)]};
+        if (m_algo == hash_algo_t::xxh64) {
+            const auto d = m_xxh.digest();
+            for (int i{}; i < 8; ++i) ret.bytes[i] = d >> (56 - i * 8);
+        } else {
+            uint8_t md[EVP_MAX_MD_SIZE];
+            u_int len{};
+            if (!EVP_DigestFinal_ex(m_sha.get(), md, &len) || len != ret.len) throw gvs::exception{"sha256 final failed"};
+            std::memcpy(ret.bytes.data(), md, len);
+        }
+        return format_hash(ret);
+    }
+
+private:
+    struct ctx_free {
+        void operator()(EVP_MD_CTX *ctx) const noexcept { EVP_MD_CTX_free(ctx); }
+    };
+
+    hash_algo_t m_algo;
+    xxh64_t m_xxh;
+    std::unique_ptr<EVP_MD_CTX, ctx_free> m_sha;
+};
+
+void pread_all(int fd, uint8_t *buf, size_t n, off_t off, const std::string &fn) {
+    for (size_t done{}; done < n;) {
+        const auto got = ::pread(fd, buf + done, n - done, off + done);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) throw gvs::exception{"%s: %s", fn.c_str(), got < 0 ? strerror(errno) : "file shrank"};
+        done += got;
+    }
+}
+
+}
+
+std::optional<hash_algo_t> hash_algo(std::string_view name) noexcept {
+    for (size_t i{}; i < names.size(); ++i) {
+        if (name == names[i]) return static_cast<hash_algo_t>(i);
+    }
+    return {};
+}
+
+const char *hash_name(hash_algo_t algo) noexcept {
+    return names[size_t(algo)];
+}
+
+size_t digest_size(hash_algo_t algo) noexcept {
+    return size_t(algo) < sizes.size() ? sizes[size_t(algo)] : 0;
+}
+
+hash_algo_t stored_algo(std::string_view hash) noexcept {
+    const auto colon = hash.find(':');
+    if (colon == std::string_view::npos) return hash_algo_t::sha256;
+    return hash_algo(hash.substr(0, colon)).value_or(hash_algo_t::sha256);
+}
+
+hash_digest_t parse_hash(std::string_view hash) noexcept {
+    hash_digest_t ret;
+    if (const auto colon = hash.find(':'); colon != std::string_view::npos) {
+        const auto algo = hash_algo(hash.substr(0, colon));
+        if (!algo) return {};
+        ret.algo = *algo;
+        hash.remove_prefix(colon + 1);
+    }
+    if (hash.size() != 2u * sizes[size_t(ret.algo)]) return {};
+    for (size_t i{}; i < hash.size() / 2; ++i) {
+        const auto hi = unhex(hash[i * 2]), lo = unhex(hash[i * 2 + 1]);
+        if (hi < 0 || lo < 0) return {};
+        ret.bytes[i] = hi << 4 | lo;
+    }
+    ret.len = hash.size() / 2;
+    return ret;
+}
+
+std::string format_hash(const hash_digest_t &digest) {
+    static constexpr const char digits[]{"0123456789abcdef"};
+    std::string ret;
+    if (digest.algo != hash_algo_t::sha256) ret = std::string{names[size_t(digest.algo)]} + ":";
+    for (size_t i{}; i < digest.len; ++i) {
+        ret.push_back(digits[digest.bytes[i] >> 4]);
+        ret.push_back(digits[digest.bytes[i] & 0xf]);
+    }
+    return ret;
+}
+
+std::string content_hash(hash_algo_t algo, const uint8_t *data, size_t size) {
+    hasher_t h{algo};
+    h.update(data, size);
+    return h.finish();
+}
+
+std::string file_hash(hash_algo_t algo, const std::string &fn) {
+    const int fd = ::open(fn.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+    const auto closer = gvs::defer([fd] { ::close(fd); });
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    hasher_t h{algo};
+    std::vector<uint8_t> buf(1 << 20);
+    while (true) {
+        const auto got = ::read(fd, buf.data(), buf.size());
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+        if (got == 0) break;
+        h.update(buf.data(), got);
+    }
+    return h.finish();
+}
+
+std::string edge_hash(hash_algo_t algo, const uint8_t *data, size_t size, size_t edge) {
+    const auto head = std::min(size, edge), tail = std::min(size - head, edge);
+    hasher_t h{algo};
+    h.update(data, head);
+    h.update(data + size - tail, tail);
+    return h.finish();
+}
+
+std::string edge_hash(hash_algo_t algo, const std::string &fn, size_t edge) {
+    const int fd = ::open(fn.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+    const auto closer = gvs::defer([fd] { ::close(fd); });
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+    const auto size = static_cast<size_t>(st.st_size);
+    const auto head = std::min(size, edge), tail = std::min(size - head, edge);
+    std::vector<uint8_t> buf(head + tail);
+    pread_all(fd, buf.data(), head, 0, fn);
+    pread_all(fd, buf.data() + head, tail, size - tail, fn);
+    return content_hash(algo, buf.data(), buf.size());
+}
@@ -0,0 +1,49 @@
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// the content hashes a database can hold. sha256 is stored as bare hex the way it always was, the others
+// with their name in front, "xxh64:...", so records hashed either way sit side by side and a file only gets
+// rehashed with another algorithm when it's being hashed anyway
+enum class hash_algo_t : uint8_t {
+    sha256,
+    xxh64,
+};
+
+// by name, for the command line
+[[nodiscard]] std::optional<hash_algo_t> hash_algo(std::string_view name) noexcept;
+[[nodiscard]] const char *hash_name(hash_algo_t algo) noexcept;
+
+// digest bytes, 0 for no such algorithm
+[[nodiscard]] size_t digest_size(hash_algo_t algo) noexcept;
+
+// the algorithm a stored hash was made with
+[[nodiscard]] hash_algo_t stored_algo(std::string_view hash) noexcept;
+
+// a hash as bytes, for keeping lots of them or in a fixed size field
+struct hash_digest_t {
+    hash_algo_t algo{};
+    uint8_t len{};
+    std::array<uint8_t, 32> bytes{};
+
+    explicit operator bool() const noexcept { return len; }
+    bool operator==(const hash_digest_t &) const noexcept = default;
+};
+
+// empty for anything that isn't a stored hash of the algorithm's size
+[[nodiscard]] hash_digest_t parse_hash(std::string_view hash) noexcept;
+[[nodiscard]] std::string format_hash(const hash_digest_t &digest);
+
+// as stored
+std::string content_hash(hash_algo_t algo, const uint8_t *data, size_t size);
+std::string file_hash(hash_algo_t algo, const std::string &fn);
+
+// of the first and last edge bytes together, of everything when the file is no bigger than both
+std::string edge_hash(hash_algo_t algo, const uint8_t *data, size_t size, size_t edge);
+std::string edge_hash(hash_algo_t algo, const std::string &fn, size_t edge);
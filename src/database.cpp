@@ -0,0 +1,173 @@
+
+#include "database.hh"
+
+#include "extract.hh"
+#include "tags.hh"
+
+#include <gvs_exception.hh>
+
+#include <cerrno>
+#include <cstring>
+#include <unordered_set>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+gvs::json::val database_t::from_store(const std::string &fn, bool with_cells) const {
+    if (!m_store) return {};
+    const auto *rec = m_store->find(fn);
+    return rec ? m_store->to_json(*rec, with_cells) : gvs::json::val{};
+}
+
+std::vector<uint8_t> database_t::cells(const std::string &fn, const point_t &grid) const {
+    return shard(fn).r([this, &fn, &grid](const auto &z) {
+        if (const auto it = z.find(fn); it != z.end()) { // written this run, only the grid's extract is looked at
+            std::vector<uint8_t> ret(sig_store_t::cells_size(grid));
+            if (!sig_store_t::layout_t::encode_cells(it->second[tag::extracts][grid_key(grid)], grid, ret.data())) ret.clear();
+            return ret;
+        }
+        const auto *rec = m_store ? m_store->find(fn) : nullptr;
+        const auto *cells = rec ? m_store->cells(*rec, grid) : nullptr;
+        return cells ? std::vector<uint8_t>(cells, cells + sig_store_t::cells_size(grid)) : std::vector<uint8_t>{};
+    });
+}
+
+std::optional<uint64_t> database_t::phash(const std::string &fn) const {
+    return shard(fn).r([this, &fn](const auto &z) -> std::optional<uint64_t> {
+        if (const auto it = z.find(fn); it != z.end()) {
+            if (const auto &jvh = it->second[tag::phash]; jvh.isStr()) return std::stoull(jvh.asStr(), nullptr, 16);
+            return {};
+        }
+        const auto *rec = m_store ? m_store->find(fn) : nullptr;
+        if (rec && rec->flags & sig_store_t::record_t::has_phash) return rec->phash;
+        return {};
+    });
+}
+
+void database_t::remove(const std::string &fn) {
+    shard(fn).w([this, &fn](auto &z) {
+        if (m_store) z[fn] = gvs::json::val{};
+        else z.erase(fn);
+        if (m_journal) m_journal->remove(fn);
+    });
+}
+
+size_t database_t::size() const {
+    size_t ret{m_store ? m_store->size() : 0};
+    for (const auto &s: m_shards) {
+        s.r([this, &ret](const auto &z) {
+            for (const auto &[fn, jv]: z) {
+                const bool stored = m_store && m_store->find(fn);
+                if (jv && !stored) ++ret;
+                else if (!jv && stored) --ret;
+            }
+        });
+    }
+    return ret;
+}
+
+void database_t::load(gvs::json::val &&db) {
+    m_store.reset();
+    for (auto &s: m_shards) s.w([](auto &z) { z.clear(); });
+    if (auto &files = db[tag::files]; files.isObj()) {
+        for (auto &[fn, jv]: files.asObj()) shard(fn).w([&fn, &jv](auto &z) { z[fn] = std::move(jv); });
+    }
+    db.remove(tag::files);
+    m_meta = std::move(db);
+    m_content_algo = hash_algo_t::sha256;
+}
+
+void database_t::open(const std::string &fn) {
+    auto store = std::make_unique<sig_store_t>(fn);
+    for (auto &s: m_shards) s.w([](auto &z) { z.clear(); });
+    m_meta = gvs::json::val{};
+    m_content_algo = store->hash_algo();
+    m_store_bytes = store->bytes();
+    m_store = std::move(store);
+}
+
+gvs::json::val database_t::release() {
+    auto ret = std::move(m_meta);
+    m_meta = gvs::json::val{};
+    auto &files = ret[tag::files];
+    if (m_store) {
+        for (size_t i{}; i < m_store->size(); ++i) {
+            const auto &rec = (*m_store)[i];
+            const std::string fn{m_store->path(rec)};
+            // what's in the shards is newer, removed ones are null there
+            if (!shard(fn).r([&fn](const auto &z) { return z.contains(fn); })) files[fn] = m_store->to_json(rec);
+        }
+    }
+    for (auto &s: m_shards) {
+        s.w([&files](auto &z) {
+            for (auto &[fn, jv]: z) {
+                if (jv) files[fn] = std::move(jv);
+            }
+            z.clear();
+        });
+    }
+    m_store.reset();
+    return ret;
+}
+
+// the shards first, noting what was in them, then the store records that weren't. a record written into a shard
+// meanwhile is still the store's and gets written from there, once either way, its journal entry has the change
+void database_t::save(const std::string &fn, const std::vector<point_t> &grids) {
+    sig_store_t::writer_t writer{fn, grids, m_content_algo};
+    // a json document from before there were several grids has the one its extracts are of
+    std::optional<point_t> extract_grid;
+    if (const auto &jvg = meta()[tag::grid]; jvg[tag::x].isInt() && jvg[tag::y].isInt()) extract_grid.emplace(jvg);
+    std::unordered_set<std::string> written;
+    for (auto &s: m_shards) {
+        s.r([this, &writer, &written, &extract_grid](const auto &z) {
+            for (const auto &[path, jv]: z) {
+                if (jv) writer.add(path, jv, extract_grid);
+                if (m_store) written.insert(path);
+            }
+        });
+    }
+    if (m_store) {
+        for (size_t i{}; i < m_store->size(); ++i) {
+            const auto &rec = (*m_store)[i];
+            if (!written.contains(m_store->path(rec))) writer.add(*m_store, rec);
+        }
+    }
+    writer.finish();
+    if (struct stat st{}; ::stat(fn.c_str(), &st) == 0) m_store_bytes = static_cast<size_t>(st.st_size);
+}
+
+size_t database_t::replay(const std::string &fn) {
+    return journal_t::replay(fn, [this](std::string &&path, std::optional<gvs::json::val> &&jv) {
+        if (jv) shard(path).w([&path, &jv](auto &z) { z[path] = std::move(*jv); });
+        else remove(path);
+    });
+}
+
+void database_t::start_journal(const std::string &fn, const std::vector<point_t> &grids) {
+    m_journal.reset();
+    m_journal = std::make_unique<journal_t>(fn, grids);
+    m_journal_fn = fn;
+    if (m_journal->resumed()) return;
+    // replayed from a journal of other grids, they'd be lost with it
+    for (const auto &s: m_shards) {
+        s.r([this](const auto &z) {
+            for (const auto &[path, jv]: z) {
+                if (jv) m_journal->put(path, jv);
+                else m_journal->remove(path);
+            }
+        });
+    }
+}
+
+void database_t::compact(const std::string &store_fn) {
+    std::lock_guard lock{m_compact_mtx};
+    if (!m_journal) {
+        save(store_fn, store_grids());
+        return;
+    }
+    // until the store is in place the rotated journal is what a restart would replay
+    const auto old_fn = m_journal_fn + ".old";
+    m_journal->rotate(old_fn);
+    save(store_fn, m_journal->grids());
+    if (::unlink(old_fn.c_str()) != 0) throw gvs::exception{"%s: %s", old_fn.c_str(), strerror(errno)};
+}
@@ -0,0 +1,155 @@
+
+#pragma once
+
+#include "content_hash.hh"
+#include "journal.hh"
+#include "point.hh"
+#include "sig_store.hh"
+
+#include <gvs_json.hh>
+#include <gvs_mutexed.hh>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// the file records of the database split by path hash into shards that lock on their own, so workers on
+// different files don't queue up behind each other. loads from and saves to the same json document as before,
+// or sits on top of a mapped binary store: the shards only get the records written or removed, reading one the
+// store has decodes it for the reader and leaves it there, and saving writes a new store from the store records
+// nobody touched plus the json ones.
+// with a journal started every write and removal gets appended to it as well, compacting folds it into the store
+class database_t {
+public:
+    static constexpr const size_t shards{64};
+
+    // f(record) under the shard's shared lock, a null val for files that have none
+    template <typename F>
+    decltype(auto) r(const std::string &fn, const F &f) const { return read(fn, f, true); }
+
+    // same without the cells of a store record, for its times and hashes
+    template <typename F>
+    decltype(auto) head(const std::string &fn, const F &f) const { return read(fn, f, false); }
+
+    // a grid's cells in fn's record, 3 bytes each in row order, straight from the store for the records nobody
+    // wrote. empty if the record doesn't have all of them
+    [[nodiscard]] std::vector<uint8_t> cells(const std::string &fn, const point_t &grid) const;
+
+    // fn's perceptual hash if the record has one
+    [[nodiscard]] std::optional<uint64_t> phash(const std::string &fn) const;
+
+    // f(record) under the shard's exclusive lock, the record gets created if it's not there. journaled after f
+    template <typename F>
+    decltype(auto) w(const std::string &fn, const F &f) {
+        return shard(fn).w([this, &fn, &f](auto &z) -> decltype(auto) {
+            auto it = z.find(fn);
+            if (it == z.end()) it = z.emplace(fn, from_store(fn, true)).first;
+            auto &rec = it->second;
+            if constexpr (std::is_void_v<std::invoke_result_t<const F &, gvs::json::val &>>) {
+                f(rec);
+                if (m_journal) m_journal->put(fn, rec);
+            } else {
+                decltype(auto) ret = f(rec);
+                if (m_journal) m_journal->put(fn, rec);
+                return ret;
+            }
+        });
+    }
+
+    // f(record) under the shard's exclusive lock for a record that's there, f says whether it changed it. only a
+    // changed record is kept in the shard and journaled
+    template <typename F>
+    bool update(const std::string &fn, const F &f) {
+        return shard(fn).w([this, &fn, &f](auto &z) {
+            auto it = z.find(fn);
+            if (it == z.end()) {
+                auto rec = from_store(fn, true);
+                if (!rec || !f(rec)) return false;
+                it = z.emplace(fn, std::move(rec)).first;
+            } else if (!it->second || !f(it->second)) {
+                return false;
+            }
+            if (m_journal) m_journal->put(fn, it->second);
+            return true;
+        });
+    }
+
+    void remove(const std::string &fn);
+
+    // everything in the document besides the file records, read-only once loaded
+    [[nodiscard]] const gvs::json::val &meta() const noexcept { return m_meta; }
+
+    [[nodiscard]] size_t size() const;
+
+    // takes the document apart into the shards
+    void load(gvs::json::val &&db);
+
+    // maps a binary store to sit under the shards
+    void open(const std::string &fn);
+
+    [[nodiscard]] std::vector<point_t> store_grids() const { return m_store ? m_store->grids() : std::vector<point_t>{}; }
+
+    // the algorithm new hashes get made with, the store's when it's opened and sha256 for a json document.
+    // saved with the store
+    [[nodiscard]] hash_algo_t content_algo() const noexcept { return m_content_algo; }
+    void content_algo(hash_algo_t algo) noexcept { m_content_algo = algo; }
+
+    // puts the document back together, the database is left empty
+    gvs::json::val release();
+
+    // writes everything as a binary store with the cells of these grids
+    void save(const std::string &fn, const std::vector<point_t> &grids);
+
+    // applies what a journal recorded on top of what's loaded, how many entries there were
+    size_t replay(const std::string &fn);
+
+    // journals every change from here on to fn, with the cells of these grids. carries on the journal there if it
+    // has them, what's in the shards goes into a new one
+    void start_journal(const std::string &fn, const std::vector<point_t> &grids);
+
+    [[nodiscard]] size_t journal_size() const noexcept { return m_journal ? m_journal->size() : 0; }
+
+    // whether a journal this big is worth folding into the store: past min_size and as big as the store, so the
+    // store gets rewritten a few times as it grows rather than every min_size
+    [[nodiscard]] bool compact_due(size_t journal_size, size_t min_size) const noexcept {
+        return journal_size > std::max(min_size, m_store_bytes.load());
+    }
+
+    // saves the store with the journal's grids and starts the journal over. writes made meanwhile land in the
+    // new journal, the store being mapped stays as it is
+    void compact(const std::string &store_fn);
+
+private:
+    typedef gvs::mutexed<std::unordered_map<std::string, gvs::json::val>> shard_t;
+
+    template <typename F>
+    decltype(auto) read(const std::string &fn, const F &f, bool with_cells) const {
+        return shard(fn).r([this, &fn, &f, with_cells](const auto &z) -> decltype(auto) {
+            const auto it = z.find(fn);
+            return it == z.end() ? f(from_store(fn, with_cells)) : f(it->second);
+        });
+    }
+
+    // the store's record for fn as json, null if it has none. removed files stay in the shards as nulls to hide it
+    [[nodiscard]] gvs::json::val from_store(const std::string &fn, bool with_cells) const;
+
+    shard_t &shard(const std::string &fn) const { return m_shards[std::hash<std::string>{}(fn) % shards]; }
+
+    mutable std::array<shard_t, shards> m_shards; // written and removed records, on top of the store's
+    gvs::json::val m_meta;
+    hash_algo_t m_content_algo{hash_algo_t::sha256};
+    std::unique_ptr<sig_store_t> m_store;
+    std::unique_ptr<journal_t> m_journal;
+    std::string m_journal_fn;
+    std::mutex m_compact_mtx;
+    std::atomic<size_t> m_store_bytes{}; // the last store opened or saved
+};
@@ -0,0 +1,46 @@
+
+#include "disjoint_sets.hh"
+
+#include <unordered_map>
+#include <vector>
+
+disjoint_sets_t::disjoint_sets_t(size_t n): m_parent{std::make_unique<std::atomic<file_id_t>[]>(n)}, m_size{n} {
+    for (size_t i{}; i < n; ++i) m_parent[i].store(i, std::memory_order_relaxed);
+}
+
+file_id_t disjoint_sets_t::find(file_id_t x) noexcept {
+    while (true) {
+        auto p = m_parent[x].load(std::memory_order_acquire);
+        if (p == x) return x;
+        const auto gp = m_parent[p].load(std::memory_order_acquire);
+        if (gp != p) m_parent[x].compare_exchange_weak(p, gp, std::memory_order_acq_rel); // somebody else's shortcut is as good
+        x = gp;
+    }
+}
+
+void disjoint_sets_t::unite(file_id_t a, file_id_t b) noexcept {
+    if (a >= m_size || b >= m_size) return;
+    while (true) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return;
+        if (a < b) std::swap(a, b);
+        // a stays a root unless another thread linked it meanwhile, then go again from the new roots
+        if (m_parent[a].compare_exchange_strong(a, b, std::memory_order_acq_rel)) return;
+    }
+}
+
+std::list<std::set<file_id_t>> disjoint_sets_t::clusters() {
+    std::vector<uint32_t> counts(m_size);
+    for (file_id_t i{}; i < m_size; ++i) ++counts[find(i)];
+    std::unordered_map<file_id_t, std::set<file_id_t> *> sets;
+    std::list<std::set<file_id_t>> ret;
+    for (file_id_t i{}; i < m_size; ++i) {
+        const auto root = find(i);
+        if (counts[root] < 2) continue;
+        auto &set = sets[root];
+        if (!set) set = &ret.emplace_back();
+        set->emplace(i);
+    }
+    return ret;
+}
@@ -0,0 +1,30 @@
+
+#pragma once
+
+#include "file_registry.hh"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <set>
+
+// union-find over file ids the matching threads feed pairs into as they find them, lock free: roots get
+// linked under the lower id with a compare-exchange, finding halves the path. near-linear for any number of
+// pairs, the clusters fall out in one pass at the end
+class disjoint_sets_t {
+public:
+    disjoint_sets_t() = default;
+    explicit disjoint_sets_t(size_t n);
+
+    [[nodiscard]] file_id_t find(file_id_t x) noexcept;
+    void unite(file_id_t a, file_id_t b) noexcept;
+
+    // every set of 2 or more
+    [[nodiscard]] std::list<std::set<file_id_t>> clusters();
+
+    [[nodiscard]] size_t size() const noexcept { return m_size; }
+
+private:
+    std::unique_ptr<std::atomic<file_id_t>[]> m_parent;
+    size_t m_size{};
+};
@@ -0,0 +1,45 @@
+
+#include "disk_order.hh"
+
+#include <gvs_defer.hh>
+#include <gvs_mutexed.hh>
+
+#include <cerrno>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace {
+
+// devices FIEMAP isn't supported on, so their files don't each get opened for nothing
+gvs::mutexed<std::unordered_set<dev_t>> no_fiemap;
+
+std::optional<uint64_t> first_extent(const std::string &fn, dev_t dev) {
+    if (no_fiemap.r([dev](const auto &z) { return z.contains(dev); })) return {};
+    const int fd = ::open(fn.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return {};
+    const auto closer = gvs::defer([fd] { ::close(fd); });
+
+    alignas(struct fiemap) uint8_t buf[sizeof(struct fiemap) + sizeof(struct fiemap_extent)]{};
+    auto *fm = reinterpret_cast<struct fiemap *>(buf);
+    fm->fm_length = FIEMAP_MAX_OFFSET;
+    fm->fm_extent_count = 1;
+    if (::ioctl(fd, FS_IOC_FIEMAP, fm) != 0) {
+        if (errno == EOPNOTSUPP || errno == ENOTTY) no_fiemap.w([dev](auto &z) { z.insert(dev); });
+        return {};
+    }
+    // not written out yet or stored in the inode, no place on the disk to go by
+    const auto &ext = fm->fm_extents[0];
+    if (fm->fm_mapped_extents == 0 || (ext.fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE))) return {};
+    return ext.fe_physical;
+}
+
+}
+
+disk_pos_t disk_pos(const std::string &fn, const struct stat &st) {
+    return {st.st_dev, st.st_ino, S_ISREG(st.st_mode) && st.st_size > 0 ? first_extent(fn, st.st_dev) : std::nullopt};
+}
@@ -0,0 +1,51 @@
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// where a file sits on its device: the physical offset of its first extent when the filesystem reports one
+// through FIEMAP, the inode number as the cheap stand-in otherwise - inodes get allocated near their data on the
+// ext/xfs family, and it's all there is on nfs
+struct disk_pos_t {
+    dev_t dev{};
+    ino_t ino{};
+    std::optional<uint64_t> offset;
+
+    // files without an extent first, they're empty, inline or their whole device has none, then by offset
+    [[nodiscard]] auto key() const noexcept { return std::make_tuple(offset.has_value(), offset.value_or(ino)); }
+};
+
+// st is fn's stat, FIEMAP only gets asked on devices that haven't said no to it yet
+disk_pos_t disk_pos(const std::string &fn, const struct stat &st);
+
+// the items in read order: each device's sorted by position, the devices taking turns so every disk gets one
+// ascending sweep instead of seeks all over the platter. pos(item) gives an item's disk_pos_t
+template <typename T, typename P>
+std::vector<T> order_by_disk(std::vector<T> &&items, const P &pos) {
+    std::map<dev_t, std::vector<T>> devs;
+    for (auto &item: items) {
+        const auto dev = pos(item).dev;
+        devs[dev].push_back(std::move(item));
+    }
+    for (auto &[dev, list]: devs) {
+        std::stable_sort(list.begin(), list.end(), [&pos](const T &a, const T &b) { return pos(a).key() < pos(b).key(); });
+    }
+    std::vector<T> ret;
+    ret.reserve(items.size());
+    for (size_t i{}; ret.size() < items.size(); ++i) {
+        for (auto &[dev, list]: devs) {
+            if (i < list.size()) ret.push_back(std::move(list[i]));
+        }
+    }
+    return ret;
+}
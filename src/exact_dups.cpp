@@ -0,0 +1,118 @@
+
+#include "exact_dups.hh"
+
+#include <algorithm>
+#include <map>
+
+std::optional<file_id_t> exact_dups_t::add(file_id_t id, const content_t &content, const hasher_t &hash) {
+    member_t self{id, parse_hash(content.partial), parse_hash(content.full)};
+    // the edges of a small file are all of it
+    const bool whole = content.size <= static_cast<off_t>(2 * EDGE);
+    std::vector<std::pair<file_id_t, stage_t>> needed;
+    std::vector<std::pair<file_id_t, std::optional<std::string>>> hashes;
+    while (true) {
+        // what the files of this size have that id doesn't know yet, if it's not settled with what's there
+        needed.clear();
+        const auto settled = m_state.w([&](auto &z) -> std::optional<std::optional<file_id_t>> {
+            if (!z.shared.contains(content.size)) {
+                const auto [single, first] = z.singles.emplace(content.size, self);
+                if (first || single->second.id == id) {
+                    if (first) ++z.resolved[by_size];
+                    return std::optional<file_id_t>{};
+                }
+                // told apart by size no more, it counts with the stage the file after it settles at
+                --z.resolved[by_size];
+                z.shared[content.size].push_back(single->second);
+                z.shared[content.size].back().uncounted = true;
+                z.singles.erase(single);
+            }
+            auto &members = z.shared[content.size];
+            const auto known = [&members](file_id_t mid) { return std::any_of(members.begin(), members.end(), [mid](const auto &m) { return m.id == mid; }); };
+            if (known(id)) return std::optional<file_id_t>{};
+            const auto add = [&](stage_t stage, std::optional<file_id_t> first) {
+                ++z.resolved[stage];
+                for (auto &m: members) {
+                    if (m.uncounted) ++z.resolved[stage];
+                    m.uncounted = false;
+                }
+                if (first) z.copies.emplace_back(*first, id);
+                else members.push_back(self);
+                return first;
+            };
+
+            // full hashes all round, from the records or a touched file's hashing, settle it without reading
+            if (self.full && std::all_of(members.begin(), members.end(), [](const auto &m) { return m.full || m.unreadable; })) {
+                for (const auto &m: members) {
+                    if (!m.unreadable && m.full == self.full) return add(by_full, m.id);
+                }
+                return add(by_full, {});
+            }
+
+            if (!self.partial) needed.emplace_back(id, by_partial);
+            for (const auto &m: members) {
+                if (!m.partial && !m.unreadable) needed.emplace_back(m.id, by_partial);
+            }
+            if (!needed.empty()) return {};
+            std::vector<const member_t *> alike;
+            for (const auto &m: members) {
+                if (!m.unreadable && m.partial == self.partial) alike.push_back(&m);
+            }
+            if (alike.empty()) return add(by_partial, {});
+            if (whole) return add(by_partial, alike.front()->id);
+
+            if (!self.full) needed.emplace_back(id, by_full);
+            for (const auto *m: alike) {
+                if (!m->full && !m->unreadable) needed.emplace_back(m->id, by_full);
+            }
+            if (!needed.empty()) return {};
+            for (const auto *m: alike) {
+                if (!m->unreadable && m->full == self.full) return add(by_full, m->id);
+            }
+            return add(by_full, {});
+        });
+        if (settled) return *settled;
+
+        // reading and hashing without holding anybody up
+        hashes.clear();
+        for (const auto &[hid, stage]: needed) hashes.emplace_back(hid, hash(hid, stage));
+        for (size_t i{}; i < needed.size(); ++i) {
+            const auto &[hid, stage] = needed[i];
+            const auto &h = hashes[i].second;
+            if (hid == id) {
+                auto &d = stage == by_partial ? self.partial : self.full;
+                if (h) d = parse_hash(*h);
+                if (!d) return {}; // unreadable, extracting it will tell
+                continue;
+            }
+            m_state.w([&](auto &z) {
+                for (auto &m: z.shared[content.size]) {
+                    if (m.id != hid) continue;
+                    if (h) (stage == by_partial ? m.partial : m.full) = parse_hash(*h);
+                    if (!h || !(stage == by_partial ? m.partial : m.full)) m.unreadable = true;
+                }
+            });
+        }
+    }
+}
+
+std::list<std::set<file_id_t>> exact_dups_t::groups() const {
+    return m_state.r([](const auto &z) {
+        std::map<file_id_t, std::set<file_id_t>> groups;
+        for (const auto &[first, copy]: z.copies) {
+            auto &group = groups[first];
+            if (group.empty()) group.emplace(first);
+            group.emplace(copy);
+        }
+        std::list<std::set<file_id_t>> ret;
+        for (auto &[first, group]: groups) ret.emplace_back(std::move(group));
+        return ret;
+    });
+}
+
+size_t exact_dups_t::copies() const {
+    return m_state.r([](const auto &z) { return z.copies.size(); });
+}
+
+std::array<size_t, exact_dups_t::stages> exact_dups_t::resolved() const {
+    return m_state.r([](const auto &z) { return z.resolved; });
+}
@@ -0,0 +1,70 @@
+
+#pragma once
+
+#include "content_hash.hh"
+#include "file_registry.hh"
+
+#include <gvs_mutexed.hh>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+// byte identical files as the hash stage comes across them, told apart by size, then by a hash of their first
+// and last EDGE bytes, then by the full hash, each only when the one before leaves a file looking like another.
+// most files have a size nobody else has and never get hashed, files that come with their full hash are compared
+// on that alone when the others of their size have theirs too. the first file with some content stands for the
+// rest: it alone gets extracted and matched, its copies go straight into its cluster
+class exact_dups_t {
+public:
+    static constexpr const size_t EDGE{64 * 1024};
+
+    enum stage_t { by_size, by_partial, by_full, stages };
+
+    // what's known of a file's content, hashes as stored, empty until worked out. all of one algorithm
+    struct content_t {
+        off_t size{};
+        std::string partial;
+        std::string full;
+    };
+
+    // a file's hash for a stage, by_partial or by_full, nothing if the file can't be read
+    using hasher_t = std::function<std::optional<std::string>(file_id_t, stage_t)>;
+
+    // the file that came first with the same content, nothing if id is the first. hashes, through hash, only
+    // what it takes to tell id apart from the files of its size, theirs as well as its own
+    std::optional<file_id_t> add(file_id_t id, const content_t &content, const hasher_t &hash);
+
+    // every first file with its copies
+    [[nodiscard]] std::list<std::set<file_id_t>> groups() const;
+
+    [[nodiscard]] size_t copies() const;
+
+    // files told apart, or found to be copies, at each stage
+    [[nodiscard]] std::array<size_t, stages> resolved() const;
+
+private:
+    struct member_t {
+        file_id_t id;
+        hash_digest_t partial;
+        hash_digest_t full;
+        bool unreadable{};
+        bool uncounted{}; // the single of its size until now, settled along with the next one
+    };
+    struct state_t {
+        std::unordered_map<off_t, member_t> singles; // sizes one file has so far, nothing hashed for them
+        std::unordered_map<off_t, std::vector<member_t>> shared; // a first file of each content
+        std::vector<std::pair<file_id_t, file_id_t>> copies; // (first, copy)
+        std::array<size_t, stages> resolved{};
+    };
+    gvs::mutexed<state_t> m_state;
+};
@@ -0,0 +1,114 @@
+
+#include "extract.hh"
+
+#include "grid_accumulator.hh"
+#include "utils.hh"
+
+#include <gvs_timer.hh>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+std::optional<extract_t> extract_bmp(const input_buf_t &buf, const std::string &fn) {
+    gvs::timer timer;
+    auto bmp = read_img(buf, fn);
+    if (!bmp) return {};
+    g::bmp_avgs.w([&bmp, &timer](auto &z) {
+        ++z.cnt;
+        z.sz += bmp->bytes();
+        z.dur += timer.dur<std::chrono::microseconds>();
+    });
+
+    const auto [b_w, b_h] = bmp->dims();
+    grid_accumulator_t acc;
+    acc.begin(b_w, b_h, bmp->pxs());
+    acc.rows(0, bmp->row(0), b_h, size_t{b_w} * bmp->pxs());
+    return extract_t{.grids = acc.avgs(), .bytes = bmp->bytes()};
+}
+
+std::optional<extract_t> extract_stream(const input_buf_t &buf, const std::string &fn) {
+    gvs::timer timer;
+    grid_accumulator_t acc;
+    if (!read_img(buf, fn, acc)) return {};
+    g::bmp_avgs.w([&acc, &timer](auto &z) {
+        ++z.cnt;
+        z.sz += acc.bytes();
+        z.dur += timer.dur<std::chrono::microseconds>();
+    });
+    return extract_t{.grids = acc.avgs(), .bytes = acc.bytes()};
+}
+
+std::optional<extract_t> extract_dc(const input_buf_t &buf, const std::string &fn) {
+    gvs::timer timer;
+    auto grids = read_img_dc(buf, fn);
+    if (!grids) return extract_stream(buf, fn); // not a jpeg we can take apart - do it the long way
+    g::bmp_avgs.w([&timer](auto &z) {
+        ++z.cnt;
+        z.dur += timer.dur<std::chrono::microseconds>();
+    });
+    return extract_t{.grids = std::move(*grids)};
+}
+
+// run both, keep the full decode and record how far the DC one is off
+std::optional<extract_t> verify_dc(const input_buf_t &buf, const std::string &fn) {
+    auto ret = extract_stream(buf, fn);
+    if (!ret) return {};
+    const auto dc = read_img_dc(buf, fn);
+    if (!dc) return ret;
+
+    g::drift_t drift{.cnt = 1};
+    for (const auto &[grid, avgs]: ret->grids) {
+        const auto &dc_avgs = dc->at(grid);
+        for (const auto &[p, full]: avgs) {
+            const auto it = dc_avgs.find(p);
+            if (it == dc_avgs.end()) {
+                ++drift.bucket_misses;
+                continue;
+            }
+            const auto &dpx = it->second;
+            ++drift.cells;
+            for (const auto d: {full.r() - dpx.r(), full.g() - dpx.g(), full.b() - dpx.b()}) {
+                drift.sum_abs += std::abs(d);
+                drift.max_abs = std::max(drift.max_abs, std::abs(d));
+            }
+            if (!(px_t::mult<0, g::PX_N, g::PX_D>(full) == px_t::mult<0, g::PX_N, g::PX_D>(dpx))) ++drift.bucket_misses;
+        }
+    }
+    g::dc_drift.w([&drift](auto &z) {
+        z.cnt += drift.cnt;
+        z.cells += drift.cells;
+        z.bucket_misses += drift.bucket_misses;
+        z.sum_abs += drift.sum_abs;
+        z.max_abs = std::max(z.max_abs, drift.max_abs);
+    });
+    return ret;
+}
+
+}
+
+std::optional<extract_t> extract(const input_buf_t &buf, const std::string &fn) {
+    if (g::verify_dc) return verify_dc(buf, fn);
+    switch (g::extractor) {
+        case g::extractor_t::bmp: return extract_bmp(buf, fn);
+        case g::extractor_t::dc: return extract_dc(buf, fn);
+        case g::extractor_t::stream: break;
+    }
+    return extract_stream(buf, fn);
+}
+
+std::optional<extract_t> extract(const std::string &fn) {
+    try {
+        return extract(read_input(fn), fn);
+    }
+    catch (const gvs::exception &ex) {
+        fprintf(stderr, "%s: %s\n", fn.c_str(), ex.what());
+    }
+
+    return {};
+}
+
+std::string grid_key(const point_t &grid) {
+    return std::to_string(grid.x) + "x" + std::to_string(grid.y);
+}
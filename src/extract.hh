@@ -0,0 +1,22 @@
+
+#pragma once
+
+#include "globals.hh"
+#include "input_buf.hh"
+
+#include <optional>
+#include <string>
+
+struct extract_t {
+    g::multigrid_t grids; // per-cell averages of every extract_grids grid, full precision
+    size_t bytes{}; // pixel data behind them
+};
+
+// grid averages of a file using the selected extractor, empty for bad files
+std::optional<extract_t> extract(const std::string &fn);
+
+// same, from bytes already in memory
+std::optional<extract_t> extract(const input_buf_t &buf, const std::string &fn);
+
+// database key of a grid, "WxH"
+std::string grid_key(const point_t &grid);
@@ -0,0 +1,126 @@
+
+#include "file_registry.hh"
+
+#include <gvs_exception.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+std::atomic<uint64_t> serials{};
+
+// the directory a thread added a file under last, the scanner hands over a folder's files one after another
+struct last_dir_t {
+    uint64_t serial{};
+    std::string path;
+    uint32_t id{};
+};
+thread_local last_dir_t last_dir;
+
+}
+
+file_registry_t::file_registry_t(): m_serial{++serials} {}
+
+const char *file_registry_t::state_t::intern(std::string_view s) {
+    if (s.empty()) return "";
+    if (s.size() > block_size) throw gvs::exception{"name too long: %.*s", static_cast<int>(s.size()), s.data()};
+    if (block_size - used < s.size()) {
+        blocks.push_back(std::make_unique<char[]>(block_size));
+        used = 0;
+    }
+    auto *ret = blocks.back().get() + used;
+    std::memcpy(ret, s.data(), s.size());
+    used += s.size();
+    bytes += s.size();
+    return ret;
+}
+
+// one component at a time from the top, each keeping its '/'
+uint32_t file_registry_t::state_t::dir(std::string_view path) {
+    uint32_t parent{none};
+    while (!path.empty()) {
+        const auto len = path.find('/') + 1;
+        const auto name = path.substr(0, len);
+        path.remove_prefix(len);
+        if (const auto it = dir_ids.find({parent, name}); it != dir_ids.end()) {
+            parent = it->second;
+            continue;
+        }
+        if (dirs.size() >= none) throw gvs::exception{"too many folders"};
+        const auto *interned = intern(name);
+        const uint32_t id = dirs.size();
+        dirs.push_back({interned, parent, static_cast<uint32_t>(len)});
+        dir_ids.emplace(std::make_pair(parent, std::string_view{interned, len}), id);
+        parent = id;
+    }
+    return parent;
+}
+
+file_id_t file_registry_t::add(std::string_view path) {
+    const auto slash = path.rfind('/');
+    const auto dir_path = slash == std::string_view::npos ? std::string_view{} : path.substr(0, slash + 1);
+    const auto name = path.substr(dir_path.size());
+    const bool same_dir = last_dir.serial == m_serial && last_dir.path == dir_path;
+
+    const auto [id, dir] = m_state.w([&](auto &z) {
+        const auto dir = same_dir ? last_dir.id : z.dir(dir_path);
+        if (z.unique) {
+            if (const auto it = z.file_ids.find({dir, name}); it != z.file_ids.end()) return std::make_pair(it->second, dir);
+        }
+        if (z.files.size() >= none) throw gvs::exception{"too many files"};
+        const file_id_t id = z.files.size();
+        const auto *interned = z.intern(name);
+        z.files.push_back({interned, dir, static_cast<uint32_t>(name.size())});
+        if (z.unique) z.file_ids.emplace(std::make_pair(dir, std::string_view{interned, name.size()}), id);
+        return std::make_pair(id, dir);
+    });
+    if (!same_dir) last_dir = {m_serial, std::string{dir_path}, dir};
+    return id;
+}
+
+void file_registry_t::unique_paths() {
+    m_state.w([](auto &z) {
+        if (z.unique) return;
+        z.unique = true;
+        for (file_id_t id{}; id < z.files.size(); ++id) {
+            const auto &file = z.files[id];
+            z.file_ids.emplace(std::make_pair(file.dir, std::string_view{file.name, file.len}), id);
+        }
+    });
+}
+
+std::string file_registry_t::path(file_id_t id) const {
+    return m_state.r([id](const auto &z) {
+        const auto &file = z.files.at(id);
+        size_t len{file.len};
+        uint32_t chain[256];
+        size_t depth{};
+        for (auto d = file.dir; d != none; d = z.dirs[d].dir) {
+            if (depth == std::size(chain)) throw gvs::exception{"folders nested too deep"};
+            chain[depth++] = d;
+            len += z.dirs[d].len;
+        }
+        std::string ret;
+        ret.reserve(len);
+        while (depth) {
+            const auto &dir = z.dirs[chain[--depth]];
+            ret.append(dir.name, dir.len);
+        }
+        ret.append(file.name, file.len);
+        return ret;
+    });
+}
+
+size_t file_registry_t::size() const {
+    return m_state.r([](const auto &z) { return z.files.size(); });
+}
+
+size_t file_registry_t::dirs() const {
+    return m_state.r([](const auto &z) { return z.dirs.size(); });
+}
+
+size_t file_registry_t::arena_bytes() const {
+    return m_state.r([](const auto &z) { return z.bytes; });
+}
@@ -0,0 +1,68 @@
+
+#pragma once
+
+#include <gvs_mutexed.hh>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// what the pipeline, the index and the matching know a file by, dense from 0 in the order files got added
+typedef uint32_t file_id_t;
+
+// file ids and their paths. a path is kept as its directory's id and the name, the name's bytes in an arena;
+// a directory is its parent's id and its own name, so the files under a folder share the whole prefix and
+// a path costs its last component plus 16 bytes. paths get put back together when asked for
+class file_registry_t {
+public:
+    file_registry_t();
+
+    // thread safe, for the scanner threads
+    file_id_t add(std::string_view path);
+
+    // from here on adding a path that's there gives its id back instead of a new one. costs a hash map entry a
+    // file, for the incremental runs that register the last run's files ahead of the scan
+    void unique_paths();
+
+    [[nodiscard]] std::string path(file_id_t id) const;
+
+    [[nodiscard]] size_t size() const;
+    [[nodiscard]] size_t dirs() const;
+    [[nodiscard]] size_t arena_bytes() const;
+
+private:
+    static constexpr const uint32_t none{~0u};
+    static constexpr const size_t block_size{1 << 20};
+
+    struct name_t {
+        const char *name; // in the arena, stays put
+        uint32_t dir; // none at the top
+        uint32_t len;
+    };
+
+    struct dir_key_hash {
+        size_t operator()(const std::pair<uint32_t, std::string_view> &k) const noexcept {
+            return std::hash<std::string_view>{}(k.second) ^ (k.first * 0x9e3779b97f4a7c15ull);
+        }
+    };
+
+    struct state_t {
+        std::vector<std::unique_ptr<char[]>> blocks;
+        size_t used{block_size}; // of the last block
+        size_t bytes{};
+        std::vector<name_t> files;
+        std::vector<name_t> dirs; // with the trailing '/'
+        std::unordered_map<std::pair<uint32_t, std::string_view>, uint32_t, dir_key_hash> dir_ids; // (parent, name) ->
+        std::unordered_map<std::pair<uint32_t, std::string_view>, file_id_t, dir_key_hash> file_ids; // (dir, name) ->
+        bool unique{};
+
+        const char *intern(std::string_view s);
+        uint32_t dir(std::string_view path);
+    };
+
+    const uint64_t m_serial; // tells registries apart for the adding threads' last directory
+    gvs::mutexed<state_t> m_state;
+};
@@ -9,30 +9,70 @@ gvs::mutexed<avgs_t> bmp_avgs;
 gvs::mutexed<avgs_t> proc_avgs;
 std::atomic_int db_recalcs{};
 
-gvs::tqueue<std::deque<string_ptr>, 111, true> file_queue;
+file_registry_t files;
 
-std::atomic_bool do_hash{true};
-std::atomic_bool do_process{true};
-std::atomic_bool do_match{true};
+bqueue_t<file_id_t> stat_queue{4096};
+bqueue_t<stated_t> order_queue{1024};
+bqueue_t<stated_t> hash_queue{1024};
+bqueue_t<to_extract_t> extract_queue{256};
+bqueue_t<read_t> read_queue{64};
+bqueue_t<indexed_t> index_queue{1024};
+std::atomic_int bad_inputs{};
+
+u_int grid_w{3};
+u_int grid_h{3};
+
+std::vector<point_t> extract_grids{{3, 3}, {8, 8}, {16, 16}};
+
+bool use_mmap{};
+bool disk_order{};
+u_int read_depth{32};
+bool use_uring{true};
+bool scaled_decode{};
+bool fused{};
+
+extractor_t extractor{extractor_t::stream};
+bool verify_dc{};
+gvs::mutexed<drift_t> dc_drift;
+
+int phash_dist{-1};
+gvs::mutexed<std::vector<std::tuple<file_id_t, uint64_t>>> phashes;
 
 // filename -> its hash
-gvs::mutexed<gvs::json::val> database;
+database_t database;
+bqueue_t<bool> compact_queue{1};
+std::atomic_bool compacting{};
 
 // file name -> info
-gvs::tqueue<std::deque<fileandgrid_t>, 111, true> fileandgrid_queue;
+bqueue_t<fileandgrid_t> fileandgrid_queue{1024};
 gvs::mutexed<std::list<fileandgrid_t>> file2grids; //
 
-gvs::mutexed<std::unordered_map<point_t, std::unordered_map<px_t, std::set<string_ptr>, px_hash>, point_hash>> grid2files;
+gvs::mutexed<std::vector<inverted_index_t::builder_t>> index_parts;
+inverted_index_t grid_index;
+
+bool symmetric{};
+gvs::mutexed<match_stats_t> match_stats;
+
+int tolerance{};
+cell_vals_t cell_vals;
+
+clustering_t clustering{clustering_t::ask};
+disjoint_sets_t clusters;
+
+hash_algo_t content_algo{hash_algo_t::sha256};
+exact_dups_t exact_dups;
+
+bool incremental{};
+match_state_t last_match;
+std::vector<std::atomic<bool>> unchanged;
 
 // main lookup table, grid elt -> set of files that have same grid elt
-//gvs::mutexed<std::unordered_map<grid_elt_t, std::set<string_ptr>, grid_elt_hash>> grid2files; // grid to filename
+//gvs::mutexed<std::unordered_map<grid_elt_t, std::set<file_id_t>, grid_elt_hash>> grid2files; // grid to filename
 
 // list of (set of matching files) groups
-gvs::mutexed<std::list<std::set<string_ptr>>> duplicates;
-
-gvs::mutexed<std::list<std::shared_ptr<std::string>>> bad_files;
+gvs::mutexed<std::list<std::set<file_id_t>>> duplicates;
 
-gvs::mutexed<worker_state_t> worker_state;
+gvs::mutexed<std::list<file_id_t>> bad_files;
 
 }
 
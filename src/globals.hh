@@ -2,38 +2,63 @@
 #pragma once
 
 #include "bmp_averager.hh"
+#include "bqueue.hh"
+#include "content_hash.hh"
+#include "database.hh"
+#include "disjoint_sets.hh"
+#include "disk_order.hh"
+#include "exact_dups.hh"
+#include "file_registry.hh"
+#include "input_buf.hh"
+#include "inverted_index.hh"
+#include "match_state.hh"
+#include "matcher.hh"
 
 #include <gvs_json.hh>
 #include <gvs_mutexed.hh>
-#include <gvs_tqueue.hh>
 
+#include <atomic>
 #include <chrono>
+#include <ctime>
 #include <deque>
 #include <list>
 #include <memory>
+#include <optional>
 #include <set>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 namespace g {
 
-constexpr const int GRID_W{3};
-constexpr const int GRID_H{3};
+// grid the images get averaged into, -g WxH
+extern u_int grid_w;
+extern u_int grid_h;
+
+// every grid extracted in the one pixel pass and stored per file, the matching grid among them
+extern std::vector<point_t> extract_grids;
+
+// minimum pixels per grid cell side when decoding at reduced resolution
+constexpr const int MIN_CELL_SIDE{32};
 
 constexpr const int PX_N{1};
 constexpr const int PX_D{32};
 
-typedef std::ratio<90, 100> PASSABLE_RATE;
+// palette reduced for lookups
+inline px_t reduced(const px_t &px) noexcept { return px_t::mult<0, PX_N, PX_D>(px); }
 
-typedef std::shared_ptr<std::string> string_ptr;
+typedef std::ratio<90, 100> PASSABLE_RATE;
 
 //map of point:average;
 typedef std::unordered_map<point_t, px_t, point_hash> pointwithavg_t;
 
+// grid dims -> that grid's point:average
+typedef std::unordered_map<point_t, pointwithavg_t, point_hash> multigrid_t;
+
 // file -> point:average
-typedef std::unique_ptr<std::tuple<string_ptr, pointwithavg_t>> fileandgrid_t;
+typedef std::unique_ptr<std::tuple<file_id_t, pointwithavg_t>> fileandgrid_t;
 
 struct avgs_t {
     size_t sz{};
@@ -48,36 +73,150 @@ extern gvs::mutexed<avgs_t> bmp_avgs;
 extern gvs::mutexed<avgs_t> proc_avgs;
 extern std::atomic_int db_recalcs;
 
-extern gvs::tqueue<std::deque<string_ptr>, 111, true> file_queue;
+// a unique input file, its modification time and size, and where it is on the disk with disk_order
+struct stated_t {
+    file_id_t id;
+    struct timespec mtime{};
+    off_t size{};
+    disk_pos_t pos;
+};
+
+// a file's lookup grid, full precision, and perceptual hash on their way to the index
+struct indexed_t {
+    file_id_t id;
+    pointwithavg_t grid;
+    std::optional<uint64_t> phash;
+};
+
+// a hashed file for the decoders, stored if its record has this run's grid and needn't be read. a touched file
+// whose record has a full hash, or fused any file that changed, comes with what it was stated as: its bytes get
+// checked against the hash before the record is trusted, or hashed for it, so it's read once for both
+struct to_extract_t {
+    file_id_t id;
+    bool stored{};
+    std::optional<stated_t> touched;
+};
+
+// a file as the read stage hands it to a decoder, no bytes if it's stored and wasn't touched, or couldn't be read
+struct read_t {
+    file_id_t id;
+    bool stored{};
+    std::optional<stated_t> touched;
+    std::optional<input_buf_t> buf;
+};
+
+// every scanned file's id and path
+extern file_registry_t files;
+
+// pipeline: scan -> stat [-> order] -> hash -> read -> extract -> index, every queue closes when the stage feeding
+// it is done
+extern bqueue_t<file_id_t> stat_queue; // scanned files, each (dev, ino) once
+extern bqueue_t<stated_t> order_queue; // stated files to sort by disk position, with disk_order
+extern bqueue_t<stated_t> hash_queue; // files with their mtime and size
+extern bqueue_t<to_extract_t> extract_queue; // hashed files
+extern bqueue_t<read_t> read_queue; // files read ahead, to the decoders
+extern bqueue_t<indexed_t> index_queue; // extracted or loaded grids, to several index threads
+extern std::atomic_int bad_inputs; // could not stat or hash
+
+// decoders read the files through mmap
+extern bool use_mmap;
+
+// hash and read the files in the order they're on their disks instead of as the scan found them. takes the whole
+// scan in before the first file gets hashed, pays off on spinning disks
+extern bool disk_order;
+
+// reads the read stage keeps in flight ahead of the decoders, through io_uring if it's there and allowed, as
+// many blocking reader threads otherwise
+extern u_int read_depth;
+extern bool use_uring;
+
+// hash changed files in full from the bytes the read stage reads for their decoders
+extern bool fused;
+
+// decode jpegs with DCT scaling sized to the grid
+extern bool scaled_decode;
+
+// how grid averages get extracted
+enum class extractor_t {
+    bmp, // full decode into a bmp_t
+    stream, // decoder rows straight into the grid
+    dc, // jpeg DC coefficients, streamed decode for anything else
+};
+extern extractor_t extractor;
+
+// extract with both and report the DC drift
+extern bool verify_dc;
 
-// flags for the workers
-extern std::atomic_bool do_hash;
-extern std::atomic_bool do_process;
-extern std::atomic_bool do_match;
+struct drift_t {
+    size_t cnt{};
+    size_t cells{};
+    size_t bucket_misses{}; // cells landing in a different lookup bucket
+    double sum_abs{};
+    int max_abs{};
+};
+extern gvs::mutexed<drift_t> dc_drift;
+
+// max hamming distance for perceptual hash matches, -1 to skip them
+extern int phash_dist;
+extern gvs::mutexed<std::vector<std::tuple<file_id_t, uint64_t>>> phashes; // file, its perceptual hash
 
 // json hashes
-extern gvs::mutexed<gvs::json::val> database;
+extern database_t database;
+
+constexpr const char *DB_JSON{"/home/gvs/database"};
+constexpr const char *DB_STORE{"/home/gvs/database.sig"};
+constexpr const char *DB_JOURNAL{"/home/gvs/database.journal"};
+constexpr const char *DB_INDEX{"/home/gvs/database.index"};
 
-extern gvs::tqueue<std::deque<fileandgrid_t>, 111, true> fileandgrid_queue;
+// journal size it gets folded into the store at, at the least. it has to be as big as the store too
+constexpr const size_t JOURNAL_COMPACT{256ul * 1024 * 1024};
+
+// the index threads ask for the journal to be folded into the store, compacting is set until it's done
+extern bqueue_t<bool> compact_queue;
+extern std::atomic_bool compacting;
+
+extern bqueue_t<fileandgrid_t> fileandgrid_queue; // indexed files to match once the index is complete
 extern gvs::mutexed<std::list<fileandgrid_t>> file2grids; // file -> grid
 
-// point -> averages -> filenames
-extern gvs::mutexed<std::unordered_map<point_t, std::unordered_map<px_t, std::set<string_ptr>, px_hash>, point_hash>> grid2files;
+// cell key -> files, each file once per point. the index threads collect a part each, built once they're done
+extern gvs::mutexed<std::vector<inverted_index_t::builder_t>> index_parts;
+extern inverted_index_t grid_index;
+
+// match each pair of files once instead of from both sides
+extern bool symmetric;
+extern gvs::mutexed<match_stats_t> match_stats;
+
+// colors this far apart can match across a bucket edge, 0 for exact buckets only
+extern int tolerance;
+extern cell_vals_t cell_vals; // filled for tolerant matching
+
+// how matched groups become the clusters to go through
+enum class clustering_t {
+    ask, // merge the groups with the old loop if the user says so
+    union_find, // matching feeds every pair into disjoint sets, no prompt
+    none, // the groups as found
+};
+extern clustering_t clustering;
+extern disjoint_sets_t clusters; // sized to the files before matching, for union_find
+
+// what new content hashes are made with, -H or the store's. existing ones stay valid with theirs until their files get hashed again
+extern hash_algo_t content_algo;
+
+// same size and content hash, only the first of those gets extracted and matched
+extern exact_dups_t exact_dups;
+
+// match only new and changed files, against each other and the index the last run left in DB_INDEX. its files
+// are registered first so their ids there are their ids here
+extern bool incremental;
+extern match_state_t last_match;
+extern std::vector<std::atomic<bool>> unchanged; // per last_match file, set by the hash stage, skipped after that
 
 // main lookup table, grid elt -> set of files that have same grid elt
-//extern gvs::mutexed<std::unordered_map<grid_elt_t, std::set<string_ptr>, grid_elt_hash>> grid2files; // grid to files
+//extern gvs::mutexed<std::unordered_map<grid_elt_t, std::set<file_id_t>, grid_elt_hash>> grid2files; // grid to files
 
 // list of (set of matching files) groups
-extern gvs::mutexed<std::list<std::set<string_ptr>>> duplicates;
-
-extern gvs::mutexed<std::list<std::shared_ptr<std::string>>> bad_files;
+extern gvs::mutexed<std::list<std::set<file_id_t>>> duplicates;
 
-// --------------------------------------
-struct worker_state_t {
-    int hashing{};
-    int processing{};
-    int matching{};
-};
-extern gvs::mutexed<worker_state_t> worker_state;
+extern gvs::mutexed<std::list<file_id_t>> bad_files;
 
 }
@@ -5,9 +5,9 @@
 
 #include <tuple>
 
-template<u_int W, u_int H>
+// maps image pixels to the cells of a gw x gh grid
 struct grid_t {
-    grid_t(u_int w, u_int h): m_w{w}, m_h{h} {}
-    point_t operator()(const point_t &p) const noexcept { return {(p.x * W) / m_w, (p.y * H) / m_h}; }
-    const u_int m_w, m_h;
+    grid_t(u_int gw, u_int gh, u_int w, u_int h): m_gw{gw}, m_gh{gh}, m_w{w}, m_h{h} {}
+    point_t operator()(const point_t &p) const noexcept { return {(p.x * m_gw) / m_w, (p.y * m_gh) / m_h}; }
+    const u_int m_gw, m_gh, m_w, m_h;
 };
@@ -0,0 +1,129 @@
+
+#include "grid_accumulator.hh"
+
+#include <gvs_exception.hh>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+typedef std::unique_ptr<grid_accum_base_t> (*factory_t)(simd_t);
+typedef std::map<std::tuple<u_int, u_int, u_int>, factory_t> dispatch_t; // w, h, pixel size -> factory
+
+// grid sides that get a specialization, every w x h combination of them
+constexpr u_int sizes[]{2, 3, 4, 6, 8, 16, 48}; // 48 is the shared grid for 3x3, 8x8 and 16x16
+
+template<u_int W, u_int H, u_int C>
+std::unique_ptr<grid_accum_base_t> make(simd_t simd) { return std::make_unique<grid_accum_t<W, H, C>>(simd); }
+
+template<u_int W, size_t... J>
+void add_row(dispatch_t &d, std::index_sequence<J...>) {
+    ((d[{W, sizes[J], 1}] = make<W, sizes[J], 1>, d[{W, sizes[J], 3}] = make<W, sizes[J], 3>), ...);
+}
+
+template<size_t... I>
+dispatch_t make_dispatch(std::index_sequence<I...>) {
+    dispatch_t ret;
+    (add_row<sizes[I]>(ret, std::make_index_sequence<std::size(sizes)>{}), ...);
+    return ret;
+}
+
+const dispatch_t dispatch{make_dispatch(std::make_index_sequence<std::size(sizes)>{})};
+
+// finest shared grid side before it's cheaper to run an accumulator per grid
+constexpr u_int MAX_SHARED_SIDE{64};
+
+}
+
+grid_sums_t grid_sums_t::reduce(u_int w, u_int h) const {
+    if (w == gw && h == gh) return *this;
+    if (gw % w || gh % h) throw gvs::exception{"%dx%d doesn't divide %dx%d", w, h, gw, gh};
+    grid_sums_t ret{w, h, pxs, std::vector<uint64_t>(w * h * pxs), std::vector<uint64_t>(w * h)};
+    for (u_int y{}; y < gh; ++y) {
+        for (u_int x{}; x < gw; ++x) {
+            const auto from = y * gw + x;
+            const auto to = (y * h / gh) * w + x * w / gw;
+            ret.cnts[to] += cnts[from];
+            for (u_int c{}; c < pxs; ++c) ret.sums[to * pxs + c] += sums[from * pxs + c];
+        }
+    }
+    return ret;
+}
+
+g::pointwithavg_t grid_sums_t::avgs() const {
+    g::pointwithavg_t ret;
+    for (u_int cy{}; cy < gh; ++cy) {
+        for (u_int cx{}; cx < gw; ++cx) {
+            const auto cell = cy * gw + cx;
+            const auto cnt = cnts[cell];
+            if (!cnt) continue;
+            auto avg = [cnt](uint64_t sum) { return static_cast<px_t::color_type>((sum + cnt / 2) / cnt); };
+            const auto *s = &sums[cell * pxs];
+            if (pxs == 1) ret.emplace(point_t{cx, cy}, px_t{avg(s[0]), avg(s[0]), avg(s[0])});
+            else ret.emplace(point_t{cx, cy}, px_t{avg(s[0]), avg(s[1]), avg(s[2])});
+        }
+    }
+    return ret;
+}
+
+grid_accum_dyn_t::grid_accum_dyn_t(u_int gw, u_int gh, u_int pxs, simd_t simd):
+        m_gw{gw}, m_gh{gh}, m_pxs{pxs}, m_sum{get_row_sum(pxs, simd)}, m_cols(gw + 1), m_sums(gw * gh * pxs), m_rows(gh) {}
+
+void grid_accum_dyn_t::begin(u_int w, u_int h) {
+    m_h = h;
+    for (u_int cx{}; cx <= m_gw; ++cx) m_cols[cx] = (cx * w + m_gw - 1) / m_gw;
+    std::fill(m_sums.begin(), m_sums.end(), 0);
+    std::fill(m_rows.begin(), m_rows.end(), 0);
+}
+
+void grid_accum_dyn_t::rows(u_int y, const uint8_t *data, u_int cnt, size_t stride) {
+    for (u_int r{}; r < cnt; ++r, data += stride) {
+        const u_int cy = (y + r) * m_gh / m_h;
+        auto *sums = &m_sums[cy * m_gw * m_pxs];
+        for (u_int cx{}; cx < m_gw; ++cx) m_sum(data + m_cols[cx] * m_pxs, m_cols[cx + 1] - m_cols[cx], sums + cx * m_pxs);
+        ++m_rows[cy];
+    }
+}
+
+grid_sums_t grid_accum_dyn_t::sums() const { return make_sums(m_gw, m_gh, m_pxs, m_sums, m_cols, m_rows); }
+
+std::unique_ptr<grid_accum_base_t> make_grid_accum(u_int gw, u_int gh, u_int pxs, simd_t simd) {
+    if (pxs != 1 && pxs != 3) throw gvs::exception{"invalid pixel dimention %d", pxs};
+    if (const auto it = dispatch.find({gw, gh, pxs}); it != dispatch.end()) return it->second(simd);
+    return std::make_unique<grid_accum_dyn_t>(gw, gh, pxs, simd);
+}
+
+void grid_accumulator_t::begin(u_int w, u_int h, u_int pxs) {
+    m_bytes = size_t{w} * h * pxs;
+    m_accs.clear();
+
+    u_int sw{1}, sh{1};
+    for (const auto &gr: m_grids) {
+        sw = std::lcm(sw, gr.x);
+        sh = std::lcm(sh, gr.y);
+    }
+    m_shared = sw <= MAX_SHARED_SIDE && sh <= MAX_SHARED_SIDE;
+    if (m_shared) {
+        m_accs.emplace_back(make_grid_accum(sw, sh, pxs, m_simd));
+    } else {
+        for (const auto &gr: m_grids) m_accs.emplace_back(make_grid_accum(gr.x, gr.y, pxs, m_simd));
+    }
+    for (auto &acc: m_accs) acc->begin(w, h);
+}
+
+g::multigrid_t grid_accumulator_t::avgs() const {
+    g::multigrid_t ret;
+    if (m_accs.empty()) return ret;
+    if (m_shared) {
+        const auto sums = m_accs.front()->sums();
+        for (const auto &gr: m_grids) ret.emplace(gr, sums.reduce(gr.x, gr.y).avgs());
+    } else {
+        for (size_t i{}; i < m_grids.size(); ++i) ret.emplace(m_grids[i], m_accs[i]->avgs());
+    }
+    return ret;
+}
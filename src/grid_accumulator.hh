@@ -0,0 +1,120 @@
+
+#pragma once
+
+#include "globals.hh"
+#include "row_kernel.hh"
+#include "scanline_sink.hh"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+// raw per-cell sums of a grid
+struct grid_sums_t {
+    u_int gw{}, gh{}, pxs{};
+    std::vector<uint64_t> sums; // pxs per cell, row major
+    std::vector<uint64_t> cnts; // pixels per cell
+
+    // folds into a coarser grid whose sides divide ours, exact since floor(floor(x * k * W / w) / k) == floor(x * W / w)
+    [[nodiscard]] grid_sums_t reduce(u_int w, u_int h) const;
+
+    // rounded averages of the non-empty cells
+    [[nodiscard]] g::pointwithavg_t avgs() const;
+};
+
+// per-cell integer sums of one image, fed a row at a time.
+// cell columns are resolved once per image, each row is summed segment by segment
+struct grid_accum_base_t {
+    virtual ~grid_accum_base_t() = default;
+    virtual void begin(u_int w, u_int h) = 0;
+    virtual void rows(u_int y, const uint8_t *data, u_int cnt, size_t stride) = 0;
+    [[nodiscard]] virtual grid_sums_t sums() const = 0;
+    [[nodiscard]] g::pointwithavg_t avgs() const { return sums().avgs(); }
+
+protected:
+    // cols are cell column starts, rows the pixel rows seen per cell row
+    template<typename S, typename X, typename Y>
+    static grid_sums_t make_sums(u_int gw, u_int gh, u_int pxs, const S &sums, const X &cols, const Y &rows) {
+        grid_sums_t ret{gw, gh, pxs, {sums.begin(), sums.end()}, std::vector<uint64_t>(gw * gh)};
+        for (u_int cy{}; cy < gh; ++cy) {
+            for (u_int cx{}; cx < gw; ++cx) ret.cnts[cy * gw + cx] = uint64_t{cols[cx + 1] - cols[cx]} * rows[cy];
+        }
+        return ret;
+    }
+};
+
+// grid size and pixel format fixed at compile time: flat arrays, fully known loops
+template<u_int W, u_int H, u_int C>
+struct grid_accum_t final: grid_accum_base_t {
+    static_assert(C == 1 || C == 3);
+
+    explicit grid_accum_t(simd_t simd): m_sum{get_row_sum(C, simd)} {}
+
+    void begin(u_int w, u_int h) override {
+        m_h = h;
+        for (u_int cx{}; cx <= W; ++cx) m_cols[cx] = (cx * w + W - 1) / W;
+        m_sums.fill(0);
+        m_rows.fill(0);
+    }
+
+    void rows(u_int y, const uint8_t *data, u_int cnt, size_t stride) override {
+        for (u_int r{}; r < cnt; ++r, data += stride) {
+            const u_int cy = (y + r) * H / m_h;
+            auto *sums = &m_sums[cy * W * C];
+            for (u_int cx{}; cx < W; ++cx) m_sum(data + m_cols[cx] * C, m_cols[cx + 1] - m_cols[cx], sums + cx * C);
+            ++m_rows[cy];
+        }
+    }
+
+    [[nodiscard]] grid_sums_t sums() const override { return make_sums(W, H, C, m_sums, m_cols, m_rows); }
+
+private:
+    row_sum_fn m_sum;
+    u_int m_h{};
+    std::array<u_int, W + 1> m_cols{};
+    std::array<uint64_t, W * H * C> m_sums{};
+    std::array<uint64_t, H> m_rows{};
+};
+
+// any grid size, for the ones without a specialization
+struct grid_accum_dyn_t final: grid_accum_base_t {
+    grid_accum_dyn_t(u_int gw, u_int gh, u_int pxs, simd_t simd);
+    void begin(u_int w, u_int h) override;
+    void rows(u_int y, const uint8_t *data, u_int cnt, size_t stride) override;
+    [[nodiscard]] grid_sums_t sums() const override;
+
+private:
+    const u_int m_gw, m_gh, m_pxs;
+    row_sum_fn m_sum;
+    u_int m_h{};
+    std::vector<u_int> m_cols;
+    std::vector<uint64_t> m_sums;
+    std::vector<uint64_t> m_rows;
+};
+
+// specialized accumulator for the grid and pixel size if there's one, dynamic otherwise
+std::unique_ptr<grid_accum_base_t> make_grid_accum(u_int gw, u_int gh, u_int pxs, simd_t simd = best_simd());
+
+// averages rows into several grids at once as a decoder pushes them, without ever holding the image.
+// all the grids come out of one accumulator at their common multiple when it's not too fine
+struct grid_accumulator_t final: scanline_sink_t {
+    explicit grid_accumulator_t(std::vector<point_t> grids = g::extract_grids, simd_t simd = best_simd()):
+            m_grids{std::move(grids)}, m_simd{simd} {}
+
+    void begin(u_int w, u_int h, u_int pxs) override;
+
+    void rows(u_int y, const uint8_t *data, u_int cnt, size_t stride) override {
+        for (auto &acc: m_accs) acc->rows(y, data, cnt, stride);
+    }
+
+    [[nodiscard]] size_t bytes() const noexcept { return m_bytes; }
+
+    [[nodiscard]] g::multigrid_t avgs() const;
+
+private:
+    std::vector<point_t> m_grids;
+    simd_t m_simd;
+    size_t m_bytes{};
+    bool m_shared{};
+    std::vector<std::unique_ptr<grid_accum_base_t>> m_accs; // the shared one, or one per grid
+};
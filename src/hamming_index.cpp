@@ -0,0 +1,25 @@
+
+#include "hamming_index.hh"
+
+hamming_index_t::hamming_index_t(std::vector<uint64_t> hashes): m_hashes{std::move(hashes)} {
+    constexpr uint32_t buckets{1U << chunk_bits};
+    for (u_int c{}; c < chunks; ++c) {
+        auto &offsets = m_offsets[c];
+        auto &ids = m_ids[c];
+        // counting sort by chunk value
+        offsets.assign(buckets + 1, 0);
+        for (const auto h: m_hashes) ++offsets[chunk(h, c) + 1];
+        for (uint32_t b{}; b < buckets; ++b) offsets[b + 1] += offsets[b];
+        ids.resize(m_hashes.size());
+        auto pos = offsets;
+        for (uint32_t i{}; i < m_hashes.size(); ++i) ids[pos[chunk(m_hashes[i], c)]++] = i;
+    }
+}
+
+std::vector<uint32_t> hamming_index_t::chunk_probes(u_int r) {
+    std::vector<uint32_t> ret;
+    for (uint32_t m{}; m < (1U << chunk_bits); ++m) {
+        if (static_cast<u_int>(__builtin_popcount(m)) <= r) ret.push_back(m);
+    }
+    return ret;
+}
@@ -0,0 +1,64 @@
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <sys/types.h>
+
+// finds all pairs of 64 bit hashes within a hamming distance without comparing everything to everything.
+// multi-index hashing: the hashes are bucketed 4 times, by each of their 16 bit chunks. two hashes
+// within k bits have at least one chunk within k / 4 bits, so only those neighbouring buckets get probed
+struct hamming_index_t {
+    static constexpr const u_int chunks{4};
+    static constexpr const u_int chunk_bits{16};
+    // past 3 bits a chunk the probes near every bucket, and it's all against all again
+    static constexpr const u_int max_k{15};
+
+    explicit hamming_index_t(std::vector<uint64_t> hashes);
+
+    [[nodiscard]] size_t size() const noexcept { return m_hashes.size(); }
+
+    [[nodiscard]] uint64_t operator[](uint32_t id) const noexcept { return m_hashes[id]; }
+
+    // cb(i, j, distance) once for every pair i < j at most k bits apart
+    template<typename F>
+    void pairs_within(u_int k, const F &cb) const {
+        const auto probes = chunk_probes(k / chunks);
+        for (uint32_t i{}; i < m_hashes.size(); ++i) {
+            const auto hi = m_hashes[i];
+            for (u_int c{}; c < chunks; ++c) {
+                const auto key = chunk(hi, c);
+                for (const auto probe: probes) {
+                    const auto bucket = key ^ probe;
+                    for (auto n = m_offsets[c][bucket]; n < m_offsets[c][bucket + 1]; ++n) {
+                        const auto j = m_ids[c][n];
+                        if (j <= i) continue;
+                        const auto hj = m_hashes[j];
+                        // report a pair only from the first chunk it's close enough in
+                        if (first_close_chunk(hi, hj, k / chunks) != c) continue;
+                        if (const u_int d = __builtin_popcountll(hi ^ hj); d <= k) cb(i, j, d);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    static uint32_t chunk(uint64_t h, u_int c) noexcept { return (h >> (c * chunk_bits)) & 0xffff; }
+
+    static u_int first_close_chunk(uint64_t a, uint64_t b, u_int r) noexcept {
+        for (u_int c{}; c < chunks; ++c) {
+            if (__builtin_popcount(chunk(a ^ b, c)) <= r) return c;
+        }
+        return chunks;
+    }
+
+    // every 16 bit xor mask of at most r bits
+    static std::vector<uint32_t> chunk_probes(u_int r);
+
+    std::vector<uint64_t> m_hashes;
+    std::array<std::vector<uint32_t>, chunks> m_offsets; // per chunk value, into m_ids
+    std::array<std::vector<uint32_t>, chunks> m_ids;
+};
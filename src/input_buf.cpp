@@ -0,0 +1,61 @@
+
+#include "input_buf.hh"
+
+#include <gvs_defer.hh>
+#include <gvs_exception.hh>
+#include <gvs_utils.hh>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+namespace {
+
+// pseudo files with made up sizes, and network/fuse ones where a file shrinking under the mapping means SIGBUS
+bool mappable(int fd) {
+    struct statfs sfs{};
+    if (::fstatfs(fd, &sfs) != 0) return false;
+    switch (static_cast<unsigned long>(sfs.f_type)) {
+        case PROC_SUPER_MAGIC:
+        case SYSFS_MAGIC:
+        case FUSE_SUPER_MAGIC:
+        case NFS_SUPER_MAGIC:
+        case SMB_SUPER_MAGIC:
+        case CIFS_SUPER_MAGIC:
+        case SMB2_SUPER_MAGIC:
+            return false;
+    }
+    return true;
+}
+
+}
+
+input_buf_t::input_buf_t(const std::string &fn, bool use_mmap) {
+    if (use_mmap) {
+        const int fd = ::open(fn.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+        auto closer = gvs::defer([fd] { ::close(fd); });
+
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+        if (S_ISREG(st.st_mode) && st.st_size > 0 && mappable(fd)) {
+            if (auto *p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0); p != MAP_FAILED) {
+                ::madvise(p, st.st_size, MADV_SEQUENTIAL);
+                m_map = static_cast<const uint8_t *>(p);
+                m_size = st.st_size;
+                return;
+            }
+        }
+    }
+    m_buf = gvs::utl::read_file<gvs::dynbuf<uint8_t>>(fn, 100);
+}
+
+input_buf_t::~input_buf_t() {
+    if (m_map) ::munmap(const_cast<uint8_t *>(m_map), m_size);
+}
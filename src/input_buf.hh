@@ -0,0 +1,30 @@
+
+#pragma once
+
+#include <gvs_dynbuf.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// a file's bytes for the decoders: mapped straight from the page cache when that's safe,
+// read into memory for the filesystems where it isn't (or when mapping is off)
+struct input_buf_t {
+    input_buf_t(const std::string &fn, bool use_mmap);
+    explicit input_buf_t(gvs::dynbuf<uint8_t> &&bytes) noexcept: m_buf{std::move(bytes)} {} // read ahead already
+    ~input_buf_t();
+
+    input_buf_t(input_buf_t &&o) noexcept: m_map{std::exchange(o.m_map, nullptr)}, m_size{o.m_size}, m_buf{std::move(o.m_buf)} {}
+    input_buf_t(const input_buf_t &) = delete;
+    input_buf_t &operator=(const input_buf_t &) = delete;
+
+    [[nodiscard]] const uint8_t *data() const noexcept { return m_map ? m_map : m_buf.data(); }
+    [[nodiscard]] size_t size() const noexcept { return m_map ? m_size : m_buf.size(); }
+    [[nodiscard]] bool mapped() const noexcept { return m_map != nullptr; }
+
+private:
+    const uint8_t *m_map{};
+    size_t m_size{};
+    gvs::dynbuf<uint8_t> m_buf;
+};
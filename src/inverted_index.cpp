@@ -0,0 +1,72 @@
+
+#include "inverted_index.hh"
+
+#include <gvs_exception.hh>
+
+#include <algorithm>
+#include <bit>
+
+void inverted_index_t::builder_t::finish() {
+    std::sort(m_pairs.begin(), m_pairs.end());
+}
+
+inverted_index_t::inverted_index_t(std::vector<builder_t> &&parts) {
+    // merge the sorted runs pairwise into the first one
+    while (parts.size() > 1) {
+        for (size_t i{}; i + 1 < parts.size(); ++i) {
+            auto &into = parts[i].m_pairs;
+            auto &from = parts[i + 1].m_pairs;
+            const auto mid = into.size();
+            into.insert(into.end(), from.begin(), from.end());
+            std::inplace_merge(into.begin(), into.begin() + mid, into.end());
+            parts.erase(parts.begin() + i + 1);
+        }
+    }
+    if (parts.empty()) return;
+    auto pairs = std::move(parts.front().m_pairs);
+    parts.clear();
+
+    m_ids.reserve(pairs.size());
+    for (size_t i{}; i < pairs.size(); ++i) {
+        const auto &[key, id] = pairs[i];
+        if (i == 0 || key != pairs[i - 1].first) {
+            m_keys.push_back(key);
+            m_offsets.push_back(m_ids.size());
+        } else if (id == pairs[i - 1].second) {
+            continue;
+        }
+        m_ids.push_back(id);
+    }
+    m_offsets.push_back(m_ids.size());
+    pairs = {};
+    hash_keys();
+}
+
+inverted_index_t::inverted_index_t(std::vector<uint64_t> &&keys, std::vector<uint64_t> &&offsets, std::vector<file_id_t> &&ids):
+        m_keys{std::move(keys)}, m_offsets{std::move(offsets)}, m_ids{std::move(ids)} {
+    if (m_offsets.size() != m_keys.size() + 1 || m_offsets.back() != m_ids.size() || !std::is_sorted(m_offsets.begin(), m_offsets.end())) {
+        throw gvs::exception{"inconsistent index, %ld key(s), %ld offset(s), %ld id(s)", m_keys.size(), m_offsets.size(), m_ids.size()};
+    }
+    hash_keys();
+}
+
+void inverted_index_t::hash_keys() {
+    if (m_keys.empty()) return;
+    const auto slots = std::bit_ceil(std::max<size_t>(m_keys.size() * 2, 16));
+    m_shift = 64 - std::countr_zero(slots);
+    m_slots.assign(slots, empty);
+    for (uint32_t i{}; i < m_keys.size(); ++i) {
+        auto s = slot(m_keys[i]);
+        while (m_slots[s] != empty) s = (s + 1) & (slots - 1);
+        m_slots[s] = i;
+    }
+}
+
+std::span<const file_id_t> inverted_index_t::find(uint64_t key) const noexcept {
+    if (m_slots.empty()) return {};
+    const auto mask = m_slots.size() - 1;
+    for (auto s = slot(key); m_slots[s] != empty; s = (s + 1) & mask) {
+        if (const auto i = m_slots[s]; m_keys[i] == key) return files(i);
+    }
+    return {};
+}
@@ -0,0 +1,68 @@
+
+#pragma once
+
+#include "file_registry.hh"
+#include "point.hh"
+#include "px.hh"
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// a lookup grid cell and its palette reduced color in one integer: x and y 16 bits each, the channels 10
+[[nodiscard]] inline uint64_t cell_key(const point_t &p, const px_t &px) noexcept {
+    return uint64_t{p.x & 0xffffu} << 48 | uint64_t{p.y & 0xffffu} << 32 | uint64_t(px.r() & 0x3ff) << 20 | uint64_t(px.g() & 0x3ff) << 10 |
+           uint64_t(px.b() & 0x3ff);
+}
+
+// cell key -> files having it, read-only once built. the keys sit in one open addressing table, the files of
+// each key next to each other in one array (CSR), so a lookup is a probe and a contiguous run of ids
+class inverted_index_t {
+public:
+    // the (key, file) pairs of one indexing thread, no locks while collecting
+    class builder_t {
+    public:
+        void add(uint64_t key, file_id_t id) { m_pairs.emplace_back(key, id); }
+
+        // sorted by the thread that collected, the index only merges the runs
+        void finish();
+
+        [[nodiscard]] size_t size() const noexcept { return m_pairs.size(); }
+
+    private:
+        friend class inverted_index_t;
+        std::vector<std::pair<uint64_t, file_id_t>> m_pairs;
+    };
+
+    inverted_index_t() = default;
+    explicit inverted_index_t(std::vector<builder_t> &&parts);
+
+    // as key(), files() had it, read back from a file: keys ascending, offsets one more than keys
+    inverted_index_t(std::vector<uint64_t> &&keys, std::vector<uint64_t> &&offsets, std::vector<file_id_t> &&ids);
+
+    // sorted by id, empty for keys nobody has
+    [[nodiscard]] std::span<const file_id_t> find(uint64_t key) const noexcept;
+
+    [[nodiscard]] size_t keys() const noexcept { return m_keys.size(); }
+    [[nodiscard]] size_t postings() const noexcept { return m_ids.size(); }
+
+    // key number i, its files
+    [[nodiscard]] uint64_t key(size_t i) const noexcept { return m_keys[i]; }
+    [[nodiscard]] std::span<const file_id_t> files(size_t i) const noexcept {
+        return {m_ids.data() + m_offsets[i], m_ids.data() + m_offsets[i + 1]};
+    }
+
+private:
+    static constexpr const uint32_t empty{~0u};
+
+    void hash_keys();
+
+    [[nodiscard]] size_t slot(uint64_t key) const noexcept { return (key * 0x9e3779b97f4a7c15ull) >> m_shift; }
+
+    std::vector<uint64_t> m_keys;
+    std::vector<uint64_t> m_offsets; // keys + 1, into m_ids
+    std::vector<file_id_t> m_ids;
+    std::vector<uint32_t> m_slots; // key numbers, power of 2
+    u_int m_shift{64};
+};
@@ -0,0 +1,207 @@
+
+#include "journal.hh"
+
+#include <gvs_defer.hh>
+#include <gvs_exception.hh>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t grids;
+    // grid dims follow
+};
+
+struct entry_t {
+    uint32_t size; // what follows the checksum
+    uint32_t checksum; // fnv-1a of it
+    uint32_t path_size;
+    // path, record
+};
+
+uint32_t checksum(const uint8_t *p, size_t n) noexcept {
+    uint32_t h{0x811c9dc5};
+    for (size_t i{}; i < n; ++i) h = (h ^ p[i]) * 0x01000193;
+    return h;
+}
+
+void write_all(int fd, const uint8_t *p, size_t n, const std::string &fn) {
+    while (n) {
+        const auto r = ::write(fd, p, n);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+        }
+        p += r;
+        n -= r;
+    }
+}
+
+// false if there's no such file
+bool read_all(const std::string &fn, std::vector<uint8_t> &data) {
+    const int fd = ::open(fn.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) return false;
+        throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+    }
+    const auto closer = gvs::defer([fd] { ::close(fd); });
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+    data.resize(st.st_size);
+    for (size_t off{}; off < data.size();) {
+        const auto r = ::pread(fd, data.data() + off, data.size() - off, off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+        if (r == 0) {
+            data.resize(off);
+            break;
+        }
+        off += r;
+    }
+    return true;
+}
+
+// the grids in a journal's header, p moved past them. nothing if data is too short to have them all
+std::optional<std::vector<point_t>> read_header(const std::string &fn, const uint8_t *&p, const uint8_t *end) {
+    if (static_cast<size_t>(end - p) < sizeof(header_t)) return {};
+    const auto &h = *reinterpret_cast<const header_t *>(p);
+    if (std::memcmp(h.magic, journal_t::magic, sizeof(journal_t::magic)) != 0 || h.version != journal_t::version || h.grids > sig_store_t::max_grids) {
+        throw gvs::exception{"%s: not a journal", fn.c_str()};
+    }
+    p += sizeof(header_t);
+    if (static_cast<size_t>(end - p) < h.grids * sizeof(sig_store_t::grid_dims_t)) return {};
+    std::vector<point_t> grids;
+    for (uint32_t i{}; i < h.grids; ++i, p += sizeof(sig_store_t::grid_dims_t)) {
+        sig_store_t::grid_dims_t dims;
+        std::memcpy(&dims, p, sizeof(dims));
+        grids.emplace_back(dims.w, dims.h);
+    }
+    return grids;
+}
+
+// cb(path, record bytes or null) per whole entry from p on, where they stop. a torn or mangled entry ends them
+template <typename F>
+const uint8_t *walk(const uint8_t *p, const uint8_t *end, size_t record_size, const F &cb) {
+    while (static_cast<size_t>(end - p) >= sizeof(entry_t)) {
+        entry_t e;
+        std::memcpy(&e, p, sizeof(e));
+        const auto *body = p + offsetof(entry_t, path_size);
+        if (e.size < sizeof(e.path_size) || static_cast<size_t>(end - body) < e.size || checksum(body, e.size) != e.checksum) break;
+        const auto rec_size = e.size - sizeof(e.path_size) - e.path_size;
+        if (e.path_size > e.size - sizeof(e.path_size) || (rec_size != 0 && rec_size != record_size)) break;
+        cb(std::string(reinterpret_cast<const char *>(p + sizeof(entry_t)), e.path_size), rec_size ? p + sizeof(entry_t) + e.path_size : nullptr);
+        p = body + e.size;
+    }
+    return p;
+}
+
+}
+
+journal_t::journal_t(std::string fn, std::vector<point_t> grids): m_fn{std::move(fn)}, m_layout{std::move(grids)} {
+    start();
+}
+
+journal_t::~journal_t() {
+    if (m_fd < 0) return;
+    ::fdatasync(m_fd);
+    ::close(m_fd);
+}
+
+// a journal of other grids, or anything else that's there, gets started over
+void journal_t::start() {
+    m_fd = ::open(m_fn.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_fd < 0) throw gvs::exception{"%s: %s", m_fn.c_str(), strerror(errno)};
+    m_resumed = false;
+    std::vector<uint8_t> data;
+    read_all(m_fn, data);
+    const auto *p = data.data();
+    const auto *end = p + data.size();
+    try {
+        if (const auto grids = read_header(m_fn, p, end); grids && *grids == m_layout.grids) {
+            m_size = static_cast<size_t>(walk(p, end, m_layout.record_size, [](std::string &&, const uint8_t *) {}) - data.data());
+            m_resumed = true;
+        }
+    } catch (...) { // not a journal
+    }
+    if (::ftruncate(m_fd, m_resumed ? static_cast<off_t>(m_size) : 0) != 0) throw gvs::exception{"%s: %s", m_fn.c_str(), strerror(errno)};
+    if (m_resumed) return;
+
+    std::vector<uint8_t> buf(sizeof(header_t));
+    auto &h = *reinterpret_cast<header_t *>(buf.data());
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.grids = m_layout.grids.size();
+    for (const auto &grid: m_layout.grids) {
+        const sig_store_t::grid_dims_t dims{static_cast<uint16_t>(grid.x), static_cast<uint16_t>(grid.y)};
+        const auto *q = reinterpret_cast<const uint8_t *>(&dims);
+        buf.insert(buf.end(), q, q + sizeof(dims));
+    }
+    write_all(m_fd, buf.data(), buf.size(), m_fn);
+    m_size = buf.size();
+}
+
+void journal_t::put(const std::string &path, const gvs::json::val &rec) {
+    std::vector<uint8_t> buf(m_layout.record_size);
+    m_layout.encode(rec, buf.data());
+    append(path, buf.data(), buf.size());
+}
+
+void journal_t::remove(const std::string &path) {
+    append(path, nullptr, 0);
+}
+
+// one write per entry, so a killed run leaves at most the last one torn
+void journal_t::append(const std::string &path, const uint8_t *rec, size_t rec_size) {
+    std::vector<uint8_t> buf(sizeof(entry_t) + path.size() + rec_size);
+    auto &e = *reinterpret_cast<entry_t *>(buf.data());
+    e.size = buf.size() - offsetof(entry_t, path_size);
+    e.path_size = path.size();
+    std::memcpy(buf.data() + sizeof(entry_t), path.data(), path.size());
+    if (rec_size) std::memcpy(buf.data() + sizeof(entry_t) + path.size(), rec, rec_size);
+    e.checksum = checksum(buf.data() + offsetof(entry_t, path_size), e.size);
+
+    std::lock_guard lock{m_mtx};
+    write_all(m_fd, buf.data(), buf.size(), m_fn);
+    m_size += buf.size();
+}
+
+void journal_t::rotate(const std::string &old_fn) {
+    std::lock_guard lock{m_mtx};
+    ::fdatasync(m_fd);
+    ::close(m_fd);
+    m_fd = -1;
+    if (::rename(m_fn.c_str(), old_fn.c_str()) != 0) throw gvs::exception{"%s: %s", m_fn.c_str(), strerror(errno)};
+    start();
+}
+
+size_t journal_t::replay(const std::string &fn, const std::function<void(std::string &&, std::optional<gvs::json::val> &&)> &cb) {
+    std::vector<uint8_t> data;
+    if (!read_all(fn, data)) return 0;
+    const auto *p = data.data();
+    const auto *end = p + data.size();
+    auto grids = read_header(fn, p, end);
+    if (!grids) return 0;
+    const sig_store_t::layout_t layout{std::move(*grids)};
+
+    size_t ret{};
+    std::vector<uint8_t> rec(layout.record_size);
+    p = walk(p, end, layout.record_size, [&](std::string &&path, const uint8_t *bytes) {
+        if (bytes) {
+            std::memcpy(rec.data(), bytes, rec.size());
+            cb(std::move(path), layout.decode(rec.data()));
+        } else {
+            cb(std::move(path), std::nullopt);
+        }
+        ++ret;
+    });
+    if (p != end) fprintf(stderr, "%s: stopped at a torn entry, %ld byte(s) left out\n", fn.c_str(), end - p);
+    return ret;
+}
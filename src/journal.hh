@@ -0,0 +1,59 @@
+
+#pragma once
+
+#include "point.hh"
+#include "sig_store.hh"
+
+#include <gvs_json.hh>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// append-only log of database record changes, written as workers finish files so an interrupted run keeps
+// its work and saving doesn't mean rewriting the store. runs carry on the same journal until it's folded into
+// the store. a header with the grids, then entries:
+//   size | checksum | path length | path | store-layout record, no record for a removal
+// replay stops at the first entry that doesn't add up, that's where a killed run stopped writing
+class journal_t {
+public:
+    static constexpr const char magic[8]{'i', 'm', 'g', 'j', 'r', 'n', 'l', '\0'};
+    static constexpr const uint32_t version{1};
+
+    // carries on the journal at fn if it has these grids, from its last whole entry. starts an empty one otherwise
+    journal_t(std::string fn, std::vector<point_t> grids);
+    ~journal_t();
+
+    journal_t(const journal_t &) = delete;
+    journal_t &operator=(const journal_t &) = delete;
+
+    void put(const std::string &path, const gvs::json::val &rec);
+    void remove(const std::string &path);
+
+    [[nodiscard]] size_t size() const noexcept { return m_size; }
+
+    // whether it carried on the entries that were there
+    [[nodiscard]] bool resumed() const noexcept { return m_resumed; }
+    [[nodiscard]] const std::vector<point_t> &grids() const noexcept { return m_layout.grids; }
+
+    // moves the entries so far to old_fn and carries on in an empty journal
+    void rotate(const std::string &old_fn);
+
+    // cb(path, record) per entry in order, no record for removals. how many there were
+    static size_t replay(const std::string &fn, const std::function<void(std::string &&, std::optional<gvs::json::val> &&)> &cb);
+
+private:
+    void start();
+    void append(const std::string &path, const uint8_t *rec, size_t rec_size);
+
+    const std::string m_fn;
+    const sig_store_t::layout_t m_layout;
+    std::mutex m_mtx;
+    int m_fd{-1};
+    std::atomic<size_t> m_size{};
+    bool m_resumed{};
+};
@@ -1,21 +1,29 @@
 
 #include "globals.hh"
+#include "hamming_index.hh"
+#include "phash.hh"
 #include "procargs.hh"
+#include "scanner.hh"
 #include "tags.hh"
+#include "uring_reader.hh"
 #include "user_interactive.hh"
 #include "worker_thread.hh"
 
+#include <gvs_exception.hh>
 #include <gvs_exec.hh>
 #include <gvs_json.hh>
-#include <gvs_scandir.hh>
 #include <gvs_timer.hh>
 #include <gvs_utils.hh>
 #include <jsonio/from_file.hh>
 #include <jsonio/to_file.hh>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <deque>
 #include <iostream>
+#include <optional>
+#include <set>
 #include <thread>
 
 #include <unistd.h>
@@ -48,104 +56,15 @@ private:
     size_t current{};
 };
 
-typedef std::list<g::string_ptr> file_list_t;
-
-template <typename F>
-void scan_file_tree(std::string path, const F &cb) {
-    try {
-        switch (gvs::utl::statx(path).st_mode & S_IFMT) {
-            case S_IFREG:
-                cb(std::move(path));
-                break;
-            case S_IFDIR:
-                if (path.back() != '/') path.push_back('/');
-                for (const auto &dx: gvs::dir{path}) {
-                    if (dx.is_those_dots()) continue;
-                    auto fn = path + dx.d_name;
-                    if (dx.is_reg()) {
-                        reg_again:
-                        cb(std::move(fn));
-                    } else if (dx.is_dir()) {
-                        dir_again:
-                        scan_file_tree(std::move(fn), cb);
-                    } else if (dx.is_unk()) {
-                        try {
-                            switch (gvs::utl::statx(fn).st_mode & S_IFMT) {
-                                case S_IFREG: goto reg_again;
-                                case S_IFDIR: goto dir_again;
-                            }
-                        } catch (const std::exception &ex) {
-                            printf("%s: %s", fn.c_str(), ex.what());
-                        }
-                    } else {
-                        printf("?%s?, %d\n", dx.d_name, dx.d_type);
-                    }
-                }
-                break;
-        }
-    } catch (const std::exception &ex) {
-        printf("%s: %s", path.c_str(), ex.what());
-    }
-}
-
-void rem_duplicate_input_files(file_list_t &list) {
-    std::map<int, std::set<decltype(std::declval<stat>().st_ino)>> inodes;
-    int duplicates{}, errors{};
-    progress_print<1000> pp{list.size()};
-    for (auto it = list.begin(); it != list.end();) {
-        pp();
-        try {
-            auto st = gvs::utl::statx(**it);
-            if (!inodes[st.st_dev].emplace(st.st_ino).second) {
-                ++duplicates;
-                it = list.erase(it);
-            } else {
-                std::advance(it, 1);
-            }
-        } catch (...) {
-            ++errors;
-            it = list.erase(it);
-        }
-    }
-    pp.done();
-
-    if (duplicates || errors) {
-        std::cout << "Removed " << duplicates << " duplicates with " << errors << " errors" << std::endl;
-    }
-}
-
-void calc_hashes(const file_list_t &list) {
-    using namespace std::chrono_literals;
-    printf("Calculating hashes...\n");
-
-    progress_print<100> pp{list.size()};
-    for (const auto &f: list) {
-        g::file_queue.push(f);
-        pp();
-    }
-    pp.done();
-    g::do_hash = false;
-    while (g::worker_state.r([](const auto &z) { return z.hashing != 0; })) std::this_thread::sleep_for(0.1s);
-
+void report() {
+    printf("Indexed %ld file(s), %d unreadable\n", g::file2grids.r([](const auto &z) { return z.size(); }), g::bad_inputs.load());
     g::hash_avgs.r([](const auto &z) {
         const auto ddur = std::chrono::duration<double>(z.dur).count();
         printf("Hashed %ld file(s) in %.1fs, %.1fps, (re)calculated %ld\n", z.cnt, ddur, (z.cnt / ddur), z.recalc);
     });
-}
-
-void process(const file_list_t &list) {
-    using namespace std::chrono_literals;
-    printf("Processing...\n");
-
-    progress_print<100> pp{list.size()};
-    for (const auto &f: list) {
-        g::file_queue.push(f);
-        pp();
-    }
-    pp.done();
-    g::do_process = false;
-    while (g::worker_state.r([](const auto &z) { return z.processing != 0; })) std::this_thread::sleep_for(0.1s);
-
+    const auto resolved = g::exact_dups.resolved();
+    printf("Told %ld file(s) apart by size, %ld by partial hash, %ld by full hash\n", resolved[exact_dups_t::by_size],
+           resolved[exact_dups_t::by_partial], resolved[exact_dups_t::by_full]);
     g::read_avgs.r([](const auto &z) {
         const auto ddur = std::chrono::duration<double>(z.dur).count();
         const auto sz = static_cast<double>(z.sz);
@@ -161,12 +80,107 @@ void process(const file_list_t &list) {
         const auto sz = static_cast<double>(z.sz);
         printf("Proc'd %ld file(s), (re)calculated %ld file(s) in %.1fs, %.1fGiBs, %.1fMiBps, %.1fps\n", z.cnt, z.recalc, ddur, (sz / 1024. / 1024. / 1024.), (sz / ddur / 1024. / 1024.), (z.cnt / ddur));
     });
+    if (g::verify_dc) {
+        g::dc_drift.r([](const auto &z) {
+            const auto samples = static_cast<double>(z.cells * px_t::num_fields);
+            printf("DC drift over %ld file(s), %ld cell(s): mean %.2f, max %d, bucket misses %ld (%.2f%%)\n", z.cnt, z.cells,
+                   samples ? z.sum_abs / samples : 0., z.max_abs, z.bucket_misses, z.cells ? 100. * z.bucket_misses / z.cells : 0.);
+        });
+    }
+    printf("Updated %d database record(s), journal at %.1fMiB\n", g::db_recalcs.load(), g::database.journal_size() / 1024. / 1024.);
+}
+
+// scan -> stat [-> order] -> hash -> read -> extract -> index, all stages running at once with bounded queues in between.
+// the decoders get their files read ahead, so it's the read depth that covers the I/O latency and the extract
+// threads only need to cover the cpus
+void run_pipeline(const std::list<std::string> &dirs) {
+    const int cpus = std::max(2u, std::thread::hardware_concurrency());
+    constexpr int stat_threads{2}, hash_threads{4}, index_threads{2};
+    const int extract_threads{cpus};
+    // mapped files are only read while they're decoded, there's nothing for a ring to do
+    const auto ring = g::use_uring && !g::use_mmap ? uring_reader_t::open(g::read_depth) : nullptr;
+    const int read_threads = ring ? 1 : static_cast<int>(g::read_depth);
+
+    g::stat_queue.producers(1);
+    g::order_queue.producers(stat_threads);
+    g::hash_queue.producers(g::disk_order ? 1 : stat_threads);
+    g::extract_queue.producers(hash_threads);
+    g::read_queue.producers(read_threads);
+    g::index_queue.producers(extract_threads);
+    g::compact_queue.producers(index_threads);
+
+    std::list<std::thread> threads;
+    const auto start = [&threads](int n, void (*fn)()) { for (int i{}; i < n; ++i) threads.emplace_back(fn); };
+    start(stat_threads, stat_stage);
+    if (g::disk_order) start(1, order_stage);
+    start(hash_threads, hash_stage);
+    if (ring) threads.emplace_back([&ring] { uring_read_stage(*ring); });
+    else start(read_threads, read_stage);
+    start(extract_threads, extract_stage);
+    start(index_threads, index_stage);
+    start(1, compact_stage);
+    printf("Reading ahead %u file(s) %s\n", g::read_depth, ring ? "through io_uring" : "with blocking reader threads");
+
+    gvs::timer timer;
+    for (const auto &dir: dirs) printf("Scanning '%s'\n", dir.c_str());
+    const auto scanned = scan_tree(dirs, std::max(8, cpus), [](std::string &&fn) {
+        g::stat_queue.push(g::files.add(fn));
+    });
+    g::stat_queue.done();
+    printf("Scanned %ld file(s) in %ld folder(s) in %.2fs, skipped %ld duplicate(s), %ld error(s)\n", scanned.files, scanned.dirs,
+           timer.measure<double>(), scanned.duplicates, scanned.errors);
+    printf("Registered %ld path(s) under %ld folder(s), %.1fMiB of names\n", g::files.size(), g::files.dirs(), g::files.arena_bytes() / 1024. / 1024.);
+    for (auto &t: threads) t.join();
+    printf("Pipeline done in %.2fs\n", timer.measure<double>());
+
+    gvs::timer index_timer;
+    g::grid_index = inverted_index_t{g::index_parts.w([](auto &z) { return std::move(z); })};
+    printf("Built the index in %.2fs, %ld key(s), %ld posting(s)\n", index_timer.measure<double>(), g::grid_index.keys(), g::grid_index.postings());
+    // the cells everybody has, dark or blown out frames, are what matching time goes into
+    for (const auto &[key, n]: matcher_t::largest_postings(g::grid_index, 5)) {
+        printf("  cell %ldx%ld color %ld,%ld,%ld: %ld file(s)\n", key >> 48, (key >> 32) & 0xffff, (key >> 20) & 0x3ff, (key >> 10) & 0x3ff, key & 0x3ff, n);
+    }
+    report();
 }
 
 void lookups() {
-    using namespace std::chrono_literals;
     printf("Matching...\n");
     auto gridlist = g::file2grids.w([](auto &z) { return std::move(z); });
+    if (g::tolerance || g::incremental) {
+        g::cell_vals = cell_vals_t{g::files.size(), {g::grid_w, g::grid_h}};
+        for (const auto &fng: gridlist) {
+            const auto &[id, grid] = *fng;
+            for (const auto &[p, px]: grid) g::cell_vals.set(id, p, px);
+        }
+    }
+    if (g::clustering == g::clustering_t::union_find) g::clusters = disjoint_sets_t{g::files.size()};
+    if (g::incremental) {
+        // the unchanged files aren't matched again, they only come up as matches of the others. their cells
+        // stay for the next state and tolerant confirming, their clusters less whoever changed since
+        size_t kept{};
+        for (file_id_t id{}; id < g::unchanged.size(); ++id) {
+            const auto *cells = g::last_match.cells.get(id);
+            if (!g::unchanged[id] || !cells) continue;
+            g::cell_vals.set(id, cells);
+            ++kept;
+            avg_t<int> avg_lum;
+            for (size_t c{}; c < g::cell_vals.cells(); ++c) avg_lum += g::reduced(px_t{cells + c * px_t::num_fields, px_t::num_fields}).lum();
+            if (avg_lum() > 2) g::duplicates.w([id](auto &list) { list.front().emplace(id); });
+        }
+        g::last_match.cells = {};
+        for (const auto &cluster: g::last_match.clusters) {
+            std::optional<file_id_t> first;
+            for (const auto id: cluster) {
+                if (id >= g::unchanged.size() || !g::unchanged[id]) continue;
+                if (first) g::clusters.unite(*first, id);
+                else first = id;
+            }
+        }
+        printf("%ld unchanged file(s) kept from the last match, %ld to match\n", kept, gridlist.size());
+    }
+    g::fileandgrid_queue.producers(1);
+    std::list<std::thread> threads;
+    for (u_int i{}, n{std::max(2u, std::thread::hardware_concurrency())}; i < n; ++i) threads.emplace_back(match_stage);
     progress_print<1000> pp{gridlist.size()};
     gvs::timer timer;
     while (!gridlist.empty()) {
@@ -176,42 +190,234 @@ void lookups() {
     }
     pp.done();
 
-    g::do_match = false;
-    while (g::worker_state.r([](const auto &z) { return z.matching != 0; })) std::this_thread::sleep_for(.1s);
+    g::fileandgrid_queue.done();
+    for (auto &t: threads) t.join();
     printf("Done running lookups in %.2fs, %.1fps\n", timer.measure<float>(), pp.size() / timer.measure<double>());
+    g::match_stats.r([](const auto &z) {
+        printf("Read %ld posting(s), %.1f candidate(s) and %.2f match(es) per file%s\n", z.postings, z.files ? double(z.candidates) / z.files : 0.,
+               z.files ? double(z.matches) / z.files : 0., g::symmetric ? ", each pair once" : "");
+    });
 }
 
-void maybe_load_db(const char *filename) {
-    g::database.w([filename](auto &z) {
-        try {
-            printf("Loading database...\n");
-            gvs::timer timer;
-            auto zz = gvs::jsonio::from_file(filename);
-            if (!zz[tag::grid].let([](const auto &z) {
-                return g::GRID_H == z[tag::y].asInt() && g::GRID_W == z[tag::x].asInt();
-            })) {
-                printf("Stale database ignored\n");
-                return;
-            }
-            z = std::move(zz);
-            printf("Database loaded in %.02fs\n", timer.measure<double>());
-        } catch (const std::exception &ex) {
-            printf("%s\n", ex.what());
+void phash_lookups() {
+    if (g::phash_dist < 0) return;
+    printf("Matching perceptual hashes...\n");
+    gvs::timer timer;
+    auto files = g::phashes.w([](auto &z) { return std::move(z); });
+    std::vector<uint64_t> hashes;
+    hashes.reserve(files.size());
+    for (const auto &[fn, h]: files) hashes.push_back(h);
+    const hamming_index_t index{std::move(hashes)};
+
+    // each file with the ones after it that are close
+    std::unordered_map<uint32_t, std::set<file_id_t>> groups;
+    size_t pairs{};
+    index.pairs_within(g::phash_dist, [&files, &groups, &pairs](uint32_t i, uint32_t j, u_int) {
+        ++pairs;
+        if (g::clustering == g::clustering_t::union_find) {
+            g::clusters.unite(std::get<0>(files[i]), std::get<0>(files[j]));
+            return;
         }
+        auto &group = groups[i];
+        if (group.empty()) group.emplace(std::get<0>(files[i]));
+        group.emplace(std::get<0>(files[j]));
+    });
+    g::duplicates.w([&groups](auto &list) {
+        for (auto &[i, group]: groups) list.emplace_back(std::move(group));
     });
+    printf("Found %ld pair(s) within %d bit(s) among %ld file(s) in %.2fs\n", pairs, g::phash_dist, files.size(), timer.measure<double>());
+}
+
+// byte identical copies go into the cluster of the file that stood for them, a group of their own unless
+// clusters are merged. the first file of a group being unreadable makes its copies so too
+void exact_clusters() {
+    auto groups = g::exact_dups.groups();
+    if (groups.empty()) return;
+    const auto bad = g::bad_files.r([](const auto &z) { return std::set<file_id_t>{z.begin(), z.end()}; });
+    for (auto it = groups.begin(); it != groups.end();) {
+        if (std::none_of(it->begin(), it->end(), [&bad](file_id_t id) { return bad.contains(id); })) {
+            ++it;
+            continue;
+        }
+        g::bad_files.w([&bad, &it](auto &z) {
+            for (const auto id: *it) if (!bad.contains(id)) z.emplace_back(id);
+        });
+        it = groups.erase(it);
+    }
+    printf("%ld exact cop(ies) of %ld file(s) left out of extraction and matching\n", g::exact_dups.copies(), groups.size());
+    if (g::clustering == g::clustering_t::union_find) {
+        for (const auto &group: groups) {
+            for (const auto id: group) g::clusters.unite(*group.begin(), id);
+        }
+        return;
+    }
+    g::duplicates.w([&groups](auto &list) { list.splice(list.end(), groups); });
+}
+
+// the grids stored per file, the ones already in the store and the ones this run extracts. past what a store
+// holds the store's grids this run doesn't extract make room, last first
+std::vector<point_t> db_grids() {
+    auto grids = g::database.store_grids();
+    for (const auto &grid: g::extract_grids) {
+        if (std::find(grids.begin(), grids.end(), grid) == grids.end()) grids.push_back(grid);
+    }
+    for (auto i = grids.size(); grids.size() > sig_store_t::max_grids && i-- > 0;) {
+        if (std::find(g::extract_grids.begin(), g::extract_grids.end(), grids[i]) != g::extract_grids.end()) continue;
+        printf("Leaving the %ux%u grid out of the store\n", grids[i].x, grids[i].y);
+        grids.erase(grids.begin() + static_cast<long>(i));
+    }
+    return grids;
+}
+
+// the binary store if there is one, the json database otherwise or when asked to import one, nothing on a first
+// run. then whatever the journal holds from earlier runs, replayed on top and carried on by this run, it only
+// gets folded into the store once it's grown big enough. a store written anew folds it in as well, an imported
+// json database leaves it behind. anything failing on the way throws with the journal left as it is for the next
+// try. new hashes get made with the algorithm asked for, or the one the store has
+void maybe_load_db(const std::string &import_json, const std::string &hash) {
+    const std::string journal_old{std::string{g::DB_JOURNAL} + ".old"};
+    gvs::timer timer;
+    bool stale{};
+    if (import_json.empty() && ::access(g::DB_STORE, F_OK) == 0) {
+        g::database.open(g::DB_STORE);
+    } else if (!import_json.empty() || ::access(g::DB_JSON, F_OK) == 0) {
+        printf("Loading database...\n");
+        // records carry every stored grid, a grid change only recalculates the files missing it
+        g::database.load(gvs::jsonio::from_file(import_json.empty() ? g::DB_JSON : import_json.c_str()));
+        stale = true;
+    }
+    if (hash.empty()) {
+        g::content_algo = g::database.content_algo();
+    } else {
+        g::content_algo = *hash_algo(hash);
+        stale |= g::content_algo != g::database.content_algo();
+        g::database.content_algo(g::content_algo);
+    }
+    if (import_json.empty()) {
+        // .old is there if a run got killed while compacting, what it has is older than the journal's. it goes
+        // into the store with the journal, the journal can't carry it on
+        const auto old = g::database.replay(journal_old);
+        const auto entries = old + g::database.replay(g::DB_JOURNAL);
+        if (entries) printf("%ld journal entr%s replayed\n", entries, entries == 1 ? "y" : "ies");
+        stale |= old > 0;
+    }
+    if (stale) {
+        g::database.save(g::DB_STORE, db_grids());
+        g::database.open(g::DB_STORE);
+        ::unlink(journal_old.c_str());
+        ::unlink(g::DB_JOURNAL);
+    }
+    printf("Database loaded in %.02fs, %ld record(s)\n", timer.measure<double>(), g::database.size());
+    g::database.start_journal(g::DB_JOURNAL, db_grids());
+}
+
+// the files the last incremental run matched go first, under the ids its index has them by. without a usable
+// state everything gets matched and the state is written anew
+void load_match_state() {
+    g::files.unique_paths();
+    try {
+        gvs::timer timer;
+        auto state = match_state_t::load(g::DB_INDEX);
+        if (!state) return;
+        if (state->grid != point_t{g::grid_w, g::grid_h} || state->px_n != g::PX_N || state->px_d != g::PX_D) {
+            printf("'%s' was matched on another grid, matching everything\n", g::DB_INDEX);
+            return;
+        }
+        for (file_id_t id{}; id < state->paths.size(); ++id) {
+            if (g::files.add(state->paths[id]) != id) throw gvs::exception{"%s: '%s' is there twice", g::DB_INDEX, state->paths[id].c_str()};
+        }
+        state->paths = {};
+        g::unchanged = std::vector<std::atomic<bool>>(g::files.size());
+        g::last_match = std::move(*state);
+        printf("Last match loaded in %.2fs, %ld file(s), %ld key(s), %ld cluster(s)\n", timer.measure<double>(), g::unchanged.size(),
+               g::last_match.index.keys(), g::last_match.clusters.size());
+    } catch (const std::exception &ex) {
+        printf("%s, matching everything\n", ex.what());
+    }
+}
+
+// every file with cells this run, renumbered in id order, its index and the clusters among them
+void save_match_state() {
+    try {
+        gvs::timer timer;
+        match_state_t state;
+        state.grid = {g::grid_w, g::grid_h};
+        state.px_n = g::PX_N;
+        state.px_d = g::PX_D;
+        constexpr const file_id_t gone{~file_id_t{}};
+        std::vector<file_id_t> renumbered(g::cell_vals.size(), gone);
+        for (file_id_t id{}; id < g::cell_vals.size(); ++id) {
+            if (!g::cell_vals.get(id)) continue;
+            renumbered[id] = state.paths.size();
+            state.paths.emplace_back(g::files.path(id));
+        }
+
+        state.cells = cell_vals_t{state.paths.size(), state.grid};
+        inverted_index_t::builder_t part;
+        for (file_id_t id{}; id < g::cell_vals.size(); ++id) {
+            if (renumbered[id] == gone) continue;
+            const auto *cells = g::cell_vals.get(id);
+            state.cells.set(renumbered[id], cells);
+            for (u_int y{}; y < state.grid.y; ++y) {
+                for (u_int x{}; x < state.grid.x; ++x, cells += px_t::num_fields) {
+                    part.add(cell_key({x, y}, g::reduced(px_t{cells, px_t::num_fields})), renumbered[id]);
+                }
+            }
+        }
+        part.finish();
+        std::vector<inverted_index_t::builder_t> parts;
+        parts.emplace_back(std::move(part));
+        state.index = inverted_index_t{std::move(parts)};
+
+        for (const auto &cluster: g::clusters.clusters()) {
+            auto &members = state.clusters.emplace_back();
+            for (const auto id: cluster) {
+                if (id < renumbered.size() && renumbered[id] != gone) members.push_back(renumbered[id]);
+            }
+            if (members.size() < 2) state.clusters.pop_back();
+        }
+        state.save(g::DB_INDEX);
+        printf("Match state saved in %.2fs, %ld file(s), %ld key(s), %ld cluster(s)\n", timer.measure<double>(), state.paths.size(),
+               state.index.keys(), state.clusters.size());
+    } catch (const std::exception &ex) {
+        printf("%s\n", ex.what());
+    }
+}
+
+// the journal already has this run's changes, the store only gets rewritten when it has grown too big
+void save_db(const std::string &export_json) {
+    gvs::timer timer;
+    if (g::database.compact_due(g::database.journal_size(), g::JOURNAL_COMPACT)) {
+        printf("compacting database...\n");
+        g::database.compact(g::DB_STORE);
+        printf("database compacted in %0.2fs\n", timer.measure<double>());
+    }
+    if (!export_json.empty()) {
+        gvs::jsonio::to_file(export_json.c_str(), 0644, g::database.release());
+        printf("database exported to '%s' in %0.2fs\n", export_json.c_str(), timer.measure<double>());
+    }
 }
 
 auto re_cluster() {
     auto duplist = g::duplicates.w([](auto &list) { return std::move(list); });
+    if (g::clustering == g::clustering_t::none) return duplist;
+    if (g::clustering == g::clustering_t::union_find) {
+        // the pairs are in the disjoint sets already, only the luminocity set is in the list
+        gvs::timer timer;
+        auto clusters = g::clusters.clusters();
+        printf("clusters: %ld in %.2fs\n", clusters.size(), timer.measure<double>());
+        duplist.splice(duplist.end(), clusters);
+        return duplist;
+    }
     std::cout << "re-cluster\ny/n?: ";
     std::string input;
     std::getline(std::cin, input);
     if (input.size() == 1 and input[0] == 'y') {
-        std::list<std::set<g::string_ptr>> ret;
+        std::list<std::set<file_id_t>> ret;
         // we don't need protection anymore - steal the duplist;
         printf("re-clustering\n");
         for (auto &dlg: duplist) { // per duplist group
-            std::set<std::shared_ptr<std::string>> *cl_p{};
+            std::set<file_id_t> *cl_p{};
             for (auto &fn: dlg) { // per file in duplist group
                 for (auto &cl: ret) { // See if this file already in some cluster
                     if (gvs::utl::container_contains(cl, fn)) {
@@ -220,7 +426,7 @@ auto re_cluster() {
                     }
                 }
                 // create a cluster if necessary
-                if (!cl_p) cl_p = &ret.emplace_back(std::set<std::shared_ptr<std::string>>{});
+                if (!cl_p) cl_p = &ret.emplace_back(std::set<file_id_t>{});
                 cl_p->emplace(fn); // add to a cluster
 
                 next_fn:;
@@ -237,57 +443,48 @@ auto re_cluster() {
 
 int main(int argc, char **argv) {
     using namespace std::literals;
-    std::list<std::thread> threads;
-
-    file_list_t all_files;
-
     gvs::exec executor{};
 
     try {
         const auto args = procargs(argc, argv);
-
-        maybe_load_db("/home/gvs/database");
+        g::grid_w = args.grid_w;
+        g::grid_h = args.grid_h;
+        g::extract_grids = args.store_grids; // with the matching grid and the perceptual hash's
+        g::phash_dist = args.phash_dist;
+        g::use_mmap = args.mmap;
+        g::disk_order = args.disk_order;
+        g::read_depth = args.read_depth;
+        g::use_uring = args.uring;
+        g::scaled_decode = args.scaled;
+        g::fused = args.fused;
+        if (args.extractor == "bmp") g::extractor = g::extractor_t::bmp;
+        else if (args.extractor == "dc") g::extractor = g::extractor_t::dc;
+        g::verify_dc = args.verify_dc;
+        g::symmetric = args.symmetric;
+        g::tolerance = args.tolerance;
+        if (args.clustering == "union") g::clustering = g::clustering_t::union_find;
+        else if (args.clustering == "none") g::clustering = g::clustering_t::none;
+        g::incremental = args.incremental;
+        if (g::incremental) g::clustering = g::clustering_t::union_find; // the stored clusters are disjoint sets
+
+        maybe_load_db(args.import_json, args.hash);
+        if (g::incremental) load_match_state();
 
         // the first "duplicate" set is for luminocity stuff
         g::duplicates.w([](auto &list) { list.emplace_back(); });
-        for (int i{}; i < 8; ++i) threads.emplace_back(worker);
-
-        {
-            progress_print<1000> pp;
-            for (const auto &dir: args.dirs) {
-                printf("Scanning '%s'\n", dir.c_str());
-                scan_file_tree(dir, [&pp, &all_files](std::string &&fn) {
-                    all_files.push_back(std::make_shared<std::string>(std::move(fn)));
-                    pp();
-                });
-                pp.done();
-            }
-        }
-        printf("Checking for input uniqueness\n");
-        rem_duplicate_input_files(all_files);
-        printf("Found %ld files\n", all_files.size());
-
-        calc_hashes(all_files);
-
-        process(all_files);
-
-        if (g::db_recalcs > 0) {
-            printf("saving database...\n");
-            gvs::timer timer;
-            g::database.w([](auto &z) {
-                z[tag::grid] = gvs::json::val{gvs::tval{tag::y, g::GRID_H}, gvs::tval{tag::x, g::GRID_W}};
-                gvs::jsonio::to_file("/home/gvs/database", 0644, z);
-                z.clear();
-            });
-            printf("database saved in %0.2fs\n", timer.measure<double>());
-        }
-        all_files.clear();
 
-        lookups();
+        run_pipeline(args.dirs);
+
+        save_db(args.export_json);
 
-        for (auto &t: threads) if (t.joinable()) t.join();
+        lookups();
+        phash_lookups();
+        exact_clusters();
+        if (g::incremental) save_match_state();
 
-        g::grid2files.w([](auto &z) { z.clear(); });
+        g::grid_index = {};
+        g::cell_vals = {};
+        g::last_match = {};
 
         deal_with_duplicates(executor, g::bad_files.w([](auto &z) { return std::move(z); }), re_cluster());
     }
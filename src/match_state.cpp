@@ -0,0 +1,179 @@
+
+#include "match_state.hh"
+
+#include <gvs_defer.hh>
+#include <gvs_exception.hh>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace {
+
+struct header_t {
+    char magic[8];
+    uint32_t version;
+    uint16_t grid_w, grid_h;
+    int32_t px_n, px_d;
+    uint64_t files;
+    uint64_t strings_size;
+    uint64_t keys;
+    uint64_t postings;
+    uint64_t clusters;
+    uint64_t members;
+};
+
+// the sections one after another, bounds checked
+class reader_t {
+public:
+    reader_t(const std::string &fn, std::vector<uint8_t> &&data): m_fn{fn}, m_data{std::move(data)} {}
+
+    template <typename T>
+    void read(T *out, size_t n) {
+        if (n > (m_data.size() - m_pos) / sizeof(T)) throw gvs::exception{"%s: damaged match state", m_fn.c_str()};
+        if (n) std::memcpy(out, m_data.data() + m_pos, n * sizeof(T));
+        m_pos += n * sizeof(T);
+    }
+
+    template <typename T>
+    std::vector<T> read(size_t n) {
+        if (n > (m_data.size() - m_pos) / sizeof(T)) throw gvs::exception{"%s: damaged match state", m_fn.c_str()};
+        std::vector<T> ret(n);
+        read(ret.data(), n);
+        return ret;
+    }
+
+    [[nodiscard]] const uint8_t *at() const noexcept { return m_data.data() + m_pos; }
+    void skip(size_t n) {
+        if (n > m_data.size() - m_pos) throw gvs::exception{"%s: damaged match state", m_fn.c_str()};
+        m_pos += n;
+    }
+
+private:
+    const std::string &m_fn;
+    std::vector<uint8_t> m_data;
+    size_t m_pos{};
+};
+
+}
+
+std::optional<match_state_t> match_state_t::load(const std::string &fn) {
+    FILE *fp = ::fopen(fn.c_str(), "r");
+    if (!fp) {
+        if (errno == ENOENT) return {};
+        throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+    }
+    const auto closer = gvs::defer([fp] { ::fclose(fp); });
+    std::vector<uint8_t> data;
+    uint8_t buf[1 << 16];
+    for (size_t n; (n = ::fread(buf, 1, sizeof(buf), fp)) > 0;) data.insert(data.end(), buf, buf + n);
+    if (::ferror(fp)) throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+
+    reader_t in{fn, std::move(data)};
+    header_t h;
+    in.read(&h, 1);
+    if (std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != version) throw gvs::exception{"%s: not a match state", fn.c_str()};
+
+    match_state_t ret;
+    ret.grid = {h.grid_w, h.grid_h};
+    ret.px_n = h.px_n;
+    ret.px_d = h.px_d;
+
+    const auto path_offs = in.read<uint64_t>(h.files);
+    const auto *strings = reinterpret_cast<const char *>(in.at());
+    in.skip(h.strings_size);
+    ret.paths.reserve(h.files);
+    for (const auto off: path_offs) {
+        if (off >= h.strings_size || !std::memchr(strings + off, 0, h.strings_size - off)) throw gvs::exception{"%s: damaged match state", fn.c_str()};
+        ret.paths.emplace_back(strings + off);
+    }
+
+    ret.cells = cell_vals_t{h.files, ret.grid};
+    const auto cells_size = ret.cells.cells() * px_t::num_fields;
+    for (file_id_t i{}; i < h.files; ++i) {
+        const auto *cells = in.at();
+        in.skip(cells_size);
+        ret.cells.set(i, cells);
+    }
+
+    auto keys = in.read<uint64_t>(h.keys);
+    auto offsets = in.read<uint64_t>(h.keys + 1);
+    auto ids = in.read<file_id_t>(h.postings);
+    ret.index = inverted_index_t{std::move(keys), std::move(offsets), std::move(ids)};
+
+    const auto cluster_offs = in.read<uint64_t>(h.clusters + 1);
+    const auto members = in.read<file_id_t>(h.members);
+    for (size_t i{}; i < h.clusters; ++i) {
+        if (cluster_offs[i] > cluster_offs[i + 1] || cluster_offs[i + 1] > members.size()) throw gvs::exception{"%s: damaged match state", fn.c_str()};
+        ret.clusters.emplace_back(members.begin() + cluster_offs[i], members.begin() + cluster_offs[i + 1]);
+    }
+    return ret;
+}
+
+void match_state_t::save(const std::string &fn) const {
+    const auto tmp = fn + ".tmp";
+    FILE *fp = ::fopen(tmp.c_str(), "w");
+    if (!fp) throw gvs::exception{"%s: %s", tmp.c_str(), strerror(errno)};
+    bool ok{true};
+    const auto write = [fp, &ok](const auto *p, size_t n) { ok = ok && (n == 0 || ::fwrite(p, sizeof(*p), n, fp) == n); };
+
+    std::vector<uint64_t> path_offs;
+    std::vector<char> strings;
+    for (const auto &path: paths) {
+        path_offs.push_back(strings.size());
+        strings.insert(strings.end(), path.c_str(), path.c_str() + path.size() + 1);
+    }
+    std::vector<uint64_t> cluster_offs{0};
+    std::vector<file_id_t> members;
+    for (const auto &cluster: clusters) {
+        members.insert(members.end(), cluster.begin(), cluster.end());
+        cluster_offs.push_back(members.size());
+    }
+
+    header_t h{};
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.grid_w = grid.x;
+    h.grid_h = grid.y;
+    h.px_n = px_n;
+    h.px_d = px_d;
+    h.files = paths.size();
+    h.strings_size = strings.size();
+    h.keys = index.keys();
+    h.postings = index.postings();
+    h.clusters = clusters.size();
+    h.members = members.size();
+
+    write(&h, 1);
+    write(path_offs.data(), path_offs.size());
+    write(strings.data(), strings.size());
+    const std::vector<uint8_t> no_cells(cells.cells() * px_t::num_fields);
+    for (file_id_t i{}; i < paths.size(); ++i) {
+        const auto *c = cells.get(i);
+        write(c ? c : no_cells.data(), no_cells.size());
+    }
+    std::vector<uint64_t> offsets{0};
+    for (size_t i{}; i < index.keys(); ++i) {
+        const auto key = index.key(i);
+        const auto ids = index.files(i);
+        write(&key, 1);
+        offsets.push_back(offsets.back() + ids.size());
+    }
+    write(offsets.data(), offsets.size());
+    for (size_t i{}; i < index.keys(); ++i) {
+        const auto ids = index.files(i);
+        write(ids.data(), ids.size());
+    }
+    write(cluster_offs.data(), cluster_offs.size());
+    write(members.data(), members.size());
+
+    ok = ok && ::fflush(fp) == 0 && ::fsync(::fileno(fp)) == 0;
+    const auto err = errno;
+    ::fclose(fp);
+    if (!ok || ::rename(tmp.c_str(), fn.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        throw gvs::exception{"%s: %s", fn.c_str(), strerror(ok ? errno : err)};
+    }
+}
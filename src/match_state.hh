@@ -0,0 +1,32 @@
+
+#pragma once
+
+#include "file_registry.hh"
+#include "inverted_index.hh"
+#include "matcher.hh"
+#include "point.hh"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+// what an incremental run picks up from the last one: the files that got matched with their lookup grids at
+// full precision, the inverted index over them and the clusters they ended up in, files by their number here.
+//   header | path offsets | paths | cells | keys | key offsets | ids | cluster offsets | cluster members
+struct match_state_t {
+    static constexpr const char magic[8]{'i', 'm', 'g', 'i', 'n', 'd', 'x', '\0'};
+    static constexpr const uint32_t version{1};
+
+    point_t grid{0, 0};
+    int px_n{}, px_d{}; // the palette reduction the index keys were made with
+    std::vector<std::string> paths;
+    cell_vals_t cells;
+    inverted_index_t index;
+    std::vector<std::vector<file_id_t>> clusters;
+
+    // nothing if there's no such file, throws if it's damaged
+    static std::optional<match_state_t> load(const std::string &fn);
+
+    // to a temporary renamed over fn when done
+    void save(const std::string &fn) const;
+};
@@ -0,0 +1,71 @@
+
+#include "matcher.hh"
+
+#include <algorithm>
+#include <limits>
+
+cell_vals_t::cell_vals_t(size_t files, point_t grid): m_grid{grid}, m_cells{size_t{grid.x} * grid.y}, m_vals(files * m_cells * px_t::num_fields), m_have(files) {}
+
+void cell_vals_t::set(file_id_t id, const point_t &p, const px_t &px) noexcept {
+    if (id >= m_have.size() || p.x >= m_grid.x || p.y >= m_grid.y) return;
+    auto *out = &m_vals[(id * m_cells + size_t{p.y} * m_grid.x + p.x) * px_t::num_fields];
+    out[0] = px.r();
+    out[1] = px.g();
+    out[2] = px.b();
+    m_have[id] = true;
+}
+
+void cell_vals_t::set(file_id_t id, const uint8_t *cells) noexcept {
+    if (id >= m_have.size()) return;
+    std::copy_n(cells, m_cells * px_t::num_fields, &m_vals[id * m_cells * px_t::num_fields]);
+    m_have[id] = true;
+}
+
+matcher_t::matcher_t(const inverted_index_t &index, size_t files, u_int threshold, bool symmetric):
+        m_index{index}, m_threshold{std::max(threshold, 1u)}, m_symmetric{symmetric}, m_counts(files) {}
+
+void matcher_t::match(file_id_t id, std::span<const uint64_t> keys, std::vector<file_id_t> &out) {
+    out.clear();
+    ++m_stats.files;
+    const auto count = [this, id](file_id_t mid) {
+        if (mid == id || mid >= m_counts.size()) return;
+        auto &count = m_counts[mid];
+        if (count == 0) m_touched.push_back(mid);
+        if (count < std::numeric_limits<uint16_t>::max()) ++count;
+    };
+    for (const auto key: keys) {
+        auto ids = m_index.find(key);
+        m_stats.postings += ids.size();
+        // postings are sorted, the lower ids had their turn at this pair already
+        if (m_symmetric) ids = ids.subspan(std::upper_bound(ids.begin(), ids.end(), id) - ids.begin());
+        for (const auto mid: ids) count(mid);
+        if (!m_stored) continue;
+        const auto stored = m_stored->find(key);
+        m_stats.postings += stored.size();
+        for (const auto mid: stored) {
+            if (mid < m_live->size() && (*m_live)[mid].load(std::memory_order_relaxed)) count(mid);
+        }
+    }
+    m_stats.candidates += m_touched.size();
+    for (const auto mid: m_touched) {
+        if (u_int{m_counts[mid]} >= m_threshold) out.push_back(mid);
+        m_counts[mid] = 0;
+    }
+    m_touched.clear();
+    m_stats.matches += out.size();
+}
+
+std::vector<std::pair<uint64_t, size_t>> matcher_t::largest_postings(const inverted_index_t &index, size_t n) {
+    std::vector<std::pair<uint64_t, size_t>> ret;
+    const auto bigger = [](const auto &a, const auto &b) { return a.second > b.second; };
+    for (size_t i{}; i < index.keys(); ++i) {
+        ret.emplace_back(index.key(i), index.files(i).size());
+        std::push_heap(ret.begin(), ret.end(), bigger);
+        if (ret.size() > n) {
+            std::pop_heap(ret.begin(), ret.end(), bigger);
+            ret.pop_back();
+        }
+    }
+    std::sort(ret.begin(), ret.end(), bigger);
+    return ret;
+}
@@ -0,0 +1,121 @@
+
+#pragma once
+
+#include "file_registry.hh"
+#include "inverted_index.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <utility>
+#include <vector>
+
+struct match_stats_t {
+    size_t files{};
+    size_t postings{}; // ids read off the index
+    size_t candidates{}; // files sharing at least one cell
+    size_t matches{};
+
+    match_stats_t &operator+=(const match_stats_t &o) noexcept {
+        files += o.files;
+        postings += o.postings;
+        candidates += o.candidates;
+        matches += o.matches;
+        return *this;
+    }
+};
+
+// the index keys to look a cell up under with colors up to tolerance off its own: its bucket, and per channel the
+// neighboring one if the color is that close to the edge. at most 8 with tolerance below a bucket's width
+template <int N, int D>
+void probe_keys(const point_t &p, const px_t &px, int tolerance, std::vector<uint64_t> &keys) {
+    const auto range = [tolerance](int v) { return std::make_pair(std::max(v - tolerance, 0) * N / D, std::min(v + tolerance, 255) * N / D); };
+    const auto [r0, r1] = range(px.r());
+    const auto [g0, g1] = range(px.g());
+    const auto [b0, b1] = range(px.b());
+    for (auto r = r0; r <= r1; ++r) {
+        for (auto g = g0; g <= g1; ++g) {
+            for (auto b = b0; b <= b1; ++b) keys.push_back(cell_key(p, {r, g, b}));
+        }
+    }
+}
+
+// every file's lookup grid at full precision, 3 bytes a cell in row order, to confirm what tolerant probing found
+class cell_vals_t {
+public:
+    cell_vals_t() = default;
+    cell_vals_t(size_t files, point_t grid);
+
+    void set(file_id_t id, const point_t &p, const px_t &px) noexcept;
+    // all of a file's cells at once, as get() has them
+    void set(file_id_t id, const uint8_t *cells) noexcept;
+
+    // a file's cells, 3 bytes each in row order, null if it has none
+    [[nodiscard]] const uint8_t *get(file_id_t id) const noexcept {
+        return id < m_have.size() && m_have[id] ? &m_vals[id * m_cells * px_t::num_fields] : nullptr;
+    }
+    [[nodiscard]] size_t size() const noexcept { return m_have.size(); }
+    [[nodiscard]] size_t cells() const noexcept { return m_cells; }
+    [[nodiscard]] const point_t &grid() const noexcept { return m_grid; }
+
+    // cells a and b agree on: every channel within tolerance, or in the same bucket as exact matching has it
+    template <int N, int D>
+    [[nodiscard]] u_int agreeing(file_id_t a, file_id_t b, int tolerance) const noexcept {
+        if (a >= m_have.size() || b >= m_have.size() || !m_have[a] || !m_have[b]) return 0;
+        const auto *pa = &m_vals[a * m_cells * px_t::num_fields];
+        const auto *pb = &m_vals[b * m_cells * px_t::num_fields];
+        u_int ret{};
+        for (size_t c{}; c < m_cells; ++c, pa += px_t::num_fields, pb += px_t::num_fields) {
+            bool near{true}, same{true};
+            for (int i{}; i < px_t::num_fields; ++i) {
+                near &= std::abs(int{pa[i]} - int{pb[i]}) <= tolerance;
+                same &= pa[i] * N / D == pb[i] * N / D;
+            }
+            ret += near || same;
+        }
+        return ret;
+    }
+
+private:
+    point_t m_grid{0, 0};
+    size_t m_cells{};
+    std::vector<uint8_t> m_vals;
+    std::vector<bool> m_have;
+};
+
+// counts, per file, the cells other files share with it. one per matching thread: the counters are a dense
+// array over all the file ids that gets reused file after file, only the touched ones reset, so a popular
+// cell costs an increment per posting instead of a hash map insert
+class matcher_t {
+public:
+    // symmetric: each pair counted once, from its lower id, instead of once from each side
+    matcher_t(const inverted_index_t &index, size_t files, u_int threshold, bool symmetric);
+
+    // a previous run's index to look the keys up in as well, for the files live says are as they were then.
+    // symmetric doesn't skip any of these, the files there don't get matched themselves
+    void add_stored(const inverted_index_t &stored, const std::vector<std::atomic<bool>> &live) noexcept {
+        m_stored = &stored;
+        m_live = &live;
+    }
+
+    // files with at least threshold of these keys in common with id, id itself left out. a file is in one of the
+    // keys of a cell at most, the probes of a cell can go in together
+    void match(file_id_t id, std::span<const uint64_t> keys, std::vector<file_id_t> &out);
+
+    [[nodiscard]] const match_stats_t &stats() const noexcept { return m_stats; }
+
+    // the n keys with the most files, biggest first
+    static std::vector<std::pair<uint64_t, size_t>> largest_postings(const inverted_index_t &index, size_t n);
+
+private:
+    const inverted_index_t &m_index;
+    const inverted_index_t *m_stored{};
+    const std::vector<std::atomic<bool>> *m_live{};
+    const u_int m_threshold;
+    const bool m_symmetric;
+    std::vector<uint16_t> m_counts; // per file id
+    std::vector<file_id_t> m_touched;
+    match_stats_t m_stats;
+};
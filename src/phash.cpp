@@ -0,0 +1,60 @@
+
+#include "phash.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+
+constexpr const u_int N{PHASH_GRID};
+constexpr const u_int BAND{8};
+
+// dct-II basis, cos((2x + 1) * u * pi / 2N)
+const auto basis = [] {
+    std::array<std::array<double, N>, N> ret{};
+    for (u_int u{}; u < N; ++u) {
+        for (u_int x{}; x < N; ++x) ret[u][x] = std::cos((2. * x + 1.) * u * M_PI / (2. * N));
+    }
+    return ret;
+}();
+
+}
+
+std::optional<uint64_t> phash(const g::pointwithavg_t &grid) {
+    if (grid.size() != N * N) return {};
+
+    std::array<std::array<double, N>, N> lum{}; // [y][x]
+    for (const auto &[p, px]: grid) {
+        if (p.x >= N || p.y >= N) return {};
+        lum[p.y][p.x] = .299 * px.r() + .587 * px.g() + .114 * px.b();
+    }
+
+    // rows first, only the frequencies we keep
+    std::array<std::array<double, BAND + 1>, N> rows{};
+    for (u_int y{}; y < N; ++y) {
+        for (u_int u{1}; u <= BAND; ++u) {
+            double s{};
+            for (u_int x{}; x < N; ++x) s += basis[u][x] * lum[y][x];
+            rows[y][u] = s;
+        }
+    }
+    std::array<double, BAND * BAND> coefs{};
+    for (u_int v{1}; v <= BAND; ++v) {
+        for (u_int u{1}; u <= BAND; ++u) {
+            double s{};
+            for (u_int y{}; y < N; ++y) s += basis[v][y] * rows[y][u];
+            coefs[(v - 1) * BAND + (u - 1)] = s;
+        }
+    }
+
+    auto sorted = coefs;
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    const auto median = sorted[sorted.size() / 2];
+
+    uint64_t ret{};
+    for (u_int i{}; i < coefs.size(); ++i) {
+        if (coefs[i] > median) ret |= uint64_t{1} << i;
+    }
+    return ret;
+}
@@ -0,0 +1,14 @@
+
+#pragma once
+
+#include "globals.hh"
+
+#include <cstdint>
+#include <optional>
+
+// the grid a perceptual hash is computed from
+constexpr const u_int PHASH_GRID{16};
+
+// 64 bit DCT perceptual hash of a 16x16 grid: the 8x8 lowest frequencies past DC, one bit each for above/below
+// their median. empty if the grid isn't complete (image smaller than the grid)
+std::optional<uint64_t> phash(const g::pointwithavg_t &grid);
@@ -1,8 +1,19 @@
 
 #include "procargs.hh"
 
+#include "content_hash.hh"
+#include "hamming_index.hh"
+#include "phash.hh"
+#include "sig_store.hh"
+
 #include <gvs_exception.hh>
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
 #include <getopt.h>
 
 namespace {
@@ -10,11 +21,65 @@ void usage() {
     throw gvs::exception(
             R"(
 Usage:
-   imgproc folder [folder]
+   imgproc [options] folder [folder]
+
+Options:
+   -g, --grid=WxH           grid the images are averaged into, default 3x3
+   -G, --store-grids=WxH,.. grids extracted in the same pass and kept per file, default 3x3,8x8,16x16.
+                            up to 31 with the -g grid and, with -p, 16x16
+   -p, --phash=K            also match by 64 bit perceptual hash, up to K differing bits, 0 to 15
+   -F, --fused              hash changed files in full from the bytes read for their decoders
+   -m, --mmap               map the files for the decoders instead of reading them into memory
+   -O, --disk-order         hash and read the files in the order they sit on their disks, by first extent
+                            where the filesystem tells, by inode otherwise. waits for the whole scan first,
+                            for spinning disks
+   -Q, --read-depth=N       reads kept in flight ahead of the decoders, default 32. dozens for network
+                            and spinning disks, they cost a file's worth of memory each, not a thread
+       --no-uring           read ahead with N blocking threads even where io_uring is available
+   -s, --scaled             decode jpegs at reduced (DCT-scaled) resolution sized to the grid
+   -e, --extractor=E        grid extraction: stream (default) decodes rows straight into the grid,
+                            bmp decodes the whole image first, dc uses the jpeg DC coefficients
+       --verify-dc          extract with both and report how far DC drifts from full decode
+   -S, --symmetric          match each pair of files once, from the file added first
+   -T, --tolerance=N        also match cell colors up to N apart across bucket edges, 1 to 31
+   -C, --cluster=C          how matches become clusters: ask (default) whether to merge the groups,
+                            union merges every matched pair as it's found without asking, none keeps the groups
+   -i, --incremental        only extract and match new or changed files, against the index and clusters the
+                            last incremental run saved. clusters are always union
+   -H, --hash=H             content hash for new and changed files: sha256, or xxh64, several times
+                            faster and enough for change detection and exact duplicates. hashes made with the
+                            other one stay valid, a file only gets rehashed when it's hashed anyway.
+                            kept in the store, the default is the one the store has, sha256 for a new one
+   -I, --import-json=FILE   start from this json database instead of the binary store
+   -J, --export-json=FILE   also write the database out as json
 )"
     );
 }
 
+// the whole of s as a number from lo to hi, usage otherwise
+int int_arg(const char *s, int lo, int hi) {
+    char *end;
+    errno = 0;
+    const auto ret = std::strtol(s, &end, 10);
+    if (end == s || *end || errno || ret < lo || ret > hi) usage();
+    return static_cast<int>(ret);
+}
+
+// a WxH grid from 1x1 to 64x64 at the start of s, s is left past it. usage otherwise
+point_t grid_arg(const char *&s) {
+    const auto dim = [&s] {
+        char *end;
+        errno = 0;
+        const auto ret = std::isdigit(static_cast<unsigned char>(*s)) ? std::strtol(s, &end, 10) : 0;
+        if (!ret || errno || ret > 64) usage();
+        s = end;
+        return static_cast<u_int>(ret);
+    };
+    const auto w = dim();
+    if (*s++ != 'x') usage();
+    return {w, dim()};
+}
+
 }
 
 opts procargs(int argc, char **argv) {
@@ -24,13 +89,118 @@ opts procargs(int argc, char **argv) {
         int this_option_optind = optind ? optind : 1;
         int option_index = 0;
         static struct option long_options[] = {
+                {"grid", required_argument, nullptr, 'g'},
+                {"store-grids", required_argument, nullptr, 'G'},
+                {"phash", required_argument, nullptr, 'p'},
+                {"fused", no_argument, nullptr, 'F'},
+                {"mmap", no_argument, nullptr, 'm'},
+                {"disk-order", no_argument, nullptr, 'O'},
+                {"read-depth", required_argument, nullptr, 'Q'},
+                {"no-uring", no_argument, nullptr, 'U'},
+                {"scaled", no_argument, nullptr, 's'},
+                {"extractor", required_argument, nullptr, 'e'},
+                {"verify-dc", no_argument, nullptr, 'V'},
+                {"symmetric", no_argument, nullptr, 'S'},
+                {"tolerance", required_argument, nullptr, 'T'},
+                {"cluster", required_argument, nullptr, 'C'},
+                {"incremental", no_argument, nullptr, 'i'},
+                {"hash", required_argument, nullptr, 'H'},
+                {"import-json", required_argument, nullptr, 'I'},
+                {"export-json", required_argument, nullptr, 'J'},
                 {nullptr, 0,              nullptr, 0}
         };
 
-        int c = getopt_long(argc, argv, "", long_options, &option_index);
+        int c = getopt_long(argc, argv, "g:G:FmOQ:p:se:ST:C:iH:I:J:", long_options, &option_index);
         if (c == -1) break;
 
         switch (c) {
+            case 'g': {
+                const char *p = optarg;
+                const auto grid = grid_arg(p);
+                if (*p) usage();
+                ret.grid_w = grid.x;
+                ret.grid_h = grid.y;
+                break;
+            }
+
+            case 'G': {
+                ret.store_grids.clear();
+                // every grid is followed by a comma and another one, or by the end
+                for (const char *p = optarg;;) {
+                    ret.store_grids.push_back(grid_arg(p));
+                    if (!*p) break;
+                    if (*p++ != ',') usage();
+                }
+                break;
+            }
+
+            case 'F':
+                ret.fused = true;
+                break;
+
+            case 'm':
+                ret.mmap = true;
+                break;
+
+            case 'O':
+                ret.disk_order = true;
+                break;
+
+            case 'Q':
+                ret.read_depth = static_cast<u_int>(int_arg(optarg, 1, 1024));
+                break;
+
+            case 'U':
+                ret.uring = false;
+                break;
+
+            case 'p':
+                ret.phash_dist = int_arg(optarg, 0, static_cast<int>(hamming_index_t::max_k));
+                break;
+
+            case 's':
+                ret.scaled = true;
+                break;
+
+            case 'e':
+                ret.extractor = optarg;
+                if (ret.extractor != "stream" && ret.extractor != "bmp" && ret.extractor != "dc") usage();
+                break;
+
+            case 'V':
+                ret.verify_dc = true;
+                break;
+
+            case 'S':
+                ret.symmetric = true;
+                break;
+
+            case 'T':
+                ret.tolerance = int_arg(optarg, 1, 31);
+                break;
+
+            case 'C':
+                ret.clustering = optarg;
+                if (ret.clustering != "ask" && ret.clustering != "union" && ret.clustering != "none") usage();
+                break;
+
+            case 'i':
+                ret.incremental = true;
+                break;
+
+            case 'H':
+                ret.hash = optarg;
+                if (!hash_algo(ret.hash)) usage();
+                break;
+
+            case 'I':
+                ret.import_json = optarg;
+                break;
+
+            case 'J':
+                ret.export_json = optarg;
+                break;
+
 //            case 'D':
 //                ret.delete_bad_files = true;
 //                break;
@@ -47,5 +217,13 @@ opts procargs(int argc, char **argv) {
 
     if (ret.dirs.empty()) usage();
 
+    // the matching grid and the perceptual hash's get extracted and stored too, a store has a flag bit per grid
+    const auto stored = [&ret](const point_t &grid) {
+        if (std::find(ret.store_grids.begin(), ret.store_grids.end(), grid) == ret.store_grids.end()) ret.store_grids.push_back(grid);
+    };
+    stored({ret.grid_w, ret.grid_h});
+    if (ret.phash_dist >= 0) stored({PHASH_GRID, PHASH_GRID});
+    if (ret.store_grids.size() > sig_store_t::max_grids) usage();
+
     return ret;
 }
@@ -1,11 +1,34 @@
 
 #pragma once
 
+#include "point.hh"
+
 #include <list>
 #include <string>
+#include <vector>
+
+#include <sys/types.h>
 
 struct opts {
     std::list<std::string> dirs;
+    u_int grid_w{3}, grid_h{3};
+    std::vector<point_t> store_grids{{3, 3}, {8, 8}, {16, 16}};
+    int phash_dist{-1};
+    bool scaled{};
+    bool fused{};
+    bool mmap{};
+    bool disk_order{};
+    u_int read_depth{32};
+    bool uring{true};
+    std::string extractor{"stream"};
+    bool verify_dc{};
+    bool symmetric{};
+    int tolerance{};
+    std::string clustering{"ask"};
+    bool incremental{};
+    std::string hash; // the store's when empty
+    std::string import_json;
+    std::string export_json;
 };
 
 opts procargs(int argc, char **argv);
@@ -0,0 +1,154 @@
+
+#include "row_kernel.hh"
+
+#include <gvs_exception.hh>
+
+#if defined(__x86_64__)
+#define ROW_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+void sum1_scalar(const uint8_t *p, u_int n, uint64_t *sums) {
+    uint64_t s{};
+    for (u_int i{}; i < n; ++i) s += p[i];
+    sums[0] += s;
+}
+
+void sum3_scalar(const uint8_t *p, u_int n, uint64_t *sums) {
+    uint64_t r{}, g{}, b{};
+    for (u_int i{}; i < n; ++i, p += 3) {
+        r += p[0];
+        g += p[1];
+        b += p[2];
+    }
+    sums[0] += r;
+    sums[1] += g;
+    sums[2] += b;
+}
+
+#ifdef ROW_KERNEL_X86
+
+// byte i of a vector loaded at an offset k (mod 3) into rgb data belongs to channel (k + i) % 3
+template<int N>
+struct rgb_masks_t {
+    constexpr rgb_masks_t() {
+        for (int k{}; k < 3; ++k) {
+            for (int c{}; c < 3; ++c) {
+                for (int i{}; i < N; ++i) m[k][c][i] = ((k + i) % 3 == c) ? 0xff : 0;
+            }
+        }
+    }
+    alignas(32) uint8_t m[3][3][N]{};
+};
+
+constexpr rgb_masks_t<16> masks16;
+constexpr rgb_masks_t<32> masks32;
+
+void sum1_sse2(const uint8_t *p, u_int n, uint64_t *sums) {
+    const auto zero = _mm_setzero_si128();
+    auto acc = zero;
+    u_int i{};
+    for (; i + 16 <= n; i += 16) {
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *) (p + i)), zero));
+    }
+    sums[0] += _mm_cvtsi128_si64(acc) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc));
+    sum1_scalar(p + i, n - i, sums);
+}
+
+void sum3_sse2(const uint8_t *p, u_int n, uint64_t *sums) {
+    const auto zero = _mm_setzero_si128();
+    __m128i acc[3]{zero, zero, zero};
+    __m128i m[3][3];
+    for (int k{}; k < 3; ++k) {
+        for (int c{}; c < 3; ++c) m[k][c] = _mm_load_si128((const __m128i *) masks16.m[k][c]);
+    }
+
+    u_int i{};
+    for (; i + 16 <= n; i += 16, p += 48) { // 16 pixels, three loads starting at channel 0, 1, 2
+        for (int j{}; j < 3; ++j) {
+            const auto v = _mm_loadu_si128((const __m128i *) (p + j * 16));
+            for (int c{}; c < 3; ++c) acc[c] = _mm_add_epi64(acc[c], _mm_sad_epu8(_mm_and_si128(v, m[j][c]), zero));
+        }
+    }
+    for (int c{}; c < 3; ++c) sums[c] += _mm_cvtsi128_si64(acc[c]) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc[c], acc[c]));
+    sum3_scalar(p, n - i, sums);
+}
+
+__attribute__((target("avx2")))
+uint64_t hsum_avx2(__m256i v) {
+    const auto s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return _mm_cvtsi128_si64(s) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(s, s));
+}
+
+__attribute__((target("avx2")))
+void sum1_avx2(const uint8_t *p, u_int n, uint64_t *sums) {
+    const auto zero = _mm256_setzero_si256();
+    auto acc = zero;
+    u_int i{};
+    for (; i + 32 <= n; i += 32) {
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *) (p + i)), zero));
+    }
+    sums[0] += hsum_avx2(acc);
+    sum1_scalar(p + i, n - i, sums);
+}
+
+__attribute__((target("avx2")))
+void sum3_avx2(const uint8_t *p, u_int n, uint64_t *sums) {
+    const auto zero = _mm256_setzero_si256();
+    __m256i acc[3]{zero, zero, zero};
+    __m256i m[3][3];
+    for (int k{}; k < 3; ++k) {
+        for (int c{}; c < 3; ++c) m[k][c] = _mm256_load_si256((const __m256i *) masks32.m[k][c]);
+    }
+
+    // 32 pixels, loads at byte 0, 32 and 64 start at channel 0, 2, 1
+    constexpr int phase[3]{0, 2, 1};
+    u_int i{};
+    for (; i + 32 <= n; i += 32, p += 96) {
+        for (int j{}; j < 3; ++j) {
+            const auto v = _mm256_loadu_si256((const __m256i *) (p + j * 32));
+            for (int c{}; c < 3; ++c) {
+                acc[c] = _mm256_add_epi64(acc[c], _mm256_sad_epu8(_mm256_and_si256(v, m[phase[j]][c]), zero));
+            }
+        }
+    }
+    for (int c{}; c < 3; ++c) sums[c] += hsum_avx2(acc[c]);
+    sum3_scalar(p, n - i, sums);
+}
+
+#endif
+
+}
+
+simd_t best_simd() noexcept {
+#ifdef ROW_KERNEL_X86
+    if (__builtin_cpu_supports("avx2")) return simd_t::avx2;
+    if (__builtin_cpu_supports("sse2")) return simd_t::sse2;
+#endif
+    return simd_t::scalar;
+}
+
+row_sum_fn get_row_sum(u_int pxs, simd_t simd) {
+    if (pxs != 1 && pxs != 3) throw gvs::exception{"invalid pixel dimention %d", pxs};
+    if (static_cast<int>(simd) > static_cast<int>(best_simd())) simd = best_simd();
+
+    switch (simd) {
+#ifdef ROW_KERNEL_X86
+        case simd_t::avx2: return pxs == 1 ? sum1_avx2 : sum3_avx2;
+        case simd_t::sse2: return pxs == 1 ? sum1_sse2 : sum3_sse2;
+#endif
+        default: break;
+    }
+    return pxs == 1 ? sum1_scalar : sum3_scalar;
+}
+
+const char *simd_name(simd_t simd) noexcept {
+    switch (simd) {
+        case simd_t::scalar: return "scalar";
+        case simd_t::sse2: return "sse2";
+        case simd_t::avx2: return "avx2";
+    }
+    return "?";
+}
@@ -0,0 +1,23 @@
+
+#pragma once
+
+#include <cstdint>
+
+#include <sys/types.h>
+
+enum class simd_t {
+    scalar,
+    sse2,
+    avx2,
+};
+
+// adds per channel sums of n consecutive pixels to sums[0..pxs)
+typedef void (*row_sum_fn)(const uint8_t *p, u_int n, uint64_t *sums);
+
+// best implementation this cpu runs
+simd_t best_simd() noexcept;
+
+// row summing kernel for 1 or 3 byte pixels, falls back to scalar when the cpu can't do simd
+row_sum_fn get_row_sum(u_int pxs, simd_t simd = best_simd());
+
+const char *simd_name(simd_t simd) noexcept;
@@ -0,0 +1,21 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/types.h>
+
+// takes decoded rows as they come out of a decoder, so the whole image doesn't have to exist at once
+struct scanline_sink_t {
+    virtual ~scanline_sink_t() = default;
+
+    // image geometry, called once before any rows
+    virtual void begin(u_int w, u_int h, u_int pxs) = 0;
+
+    // where row y should be decoded to, nullptr lets the decoder use its own scratch
+    virtual uint8_t *row_buf(u_int y) { return nullptr; }
+
+    // cnt rows starting at y, stride bytes apart
+    virtual void rows(u_int y, const uint8_t *data, u_int cnt, size_t stride) = 0;
+};
@@ -0,0 +1,209 @@
+
+#include "scanner.hh"
+
+#include <gvs_mutexed.hh>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// (device, inode) pairs seen, sharded so the scanning threads rarely meet on a lock
+class dev_ino_set_t {
+public:
+    // true the first time
+    bool insert(dev_t dev, ino_t ino) {
+        const auto h = std::hash<uint64_t>{}(ino) ^ (std::hash<uint64_t>{}(dev) * 0x9e3779b97f4a7c15ull);
+        return m_shards[h % shards].w([dev, ino](auto &z) { return z.emplace(dev, ino).second; });
+    }
+
+private:
+    struct key_hash {
+        size_t operator()(const std::pair<dev_t, ino_t> &k) const noexcept {
+            return std::hash<uint64_t>{}(k.second) ^ (std::hash<uint64_t>{}(k.first) << 1);
+        }
+    };
+
+    static constexpr const size_t shards{64};
+    std::array<gvs::mutexed<std::unordered_set<std::pair<dev_t, ino_t>, key_hash>>, shards> m_shards;
+};
+
+struct dir_fd_t {
+    explicit dir_fd_t(int fd): fd{fd} {}
+    ~dir_fd_t() { ::close(fd); }
+    const int fd;
+};
+
+struct dir_t {
+    std::shared_ptr<dir_fd_t> parent; // the fd name is opened relative to, none for the roots
+    std::string name;
+    std::string path; // with the trailing '/'
+};
+
+class scanner_t {
+public:
+    explicit scanner_t(const std::function<void(std::string &&)> &cb): cb{cb} {}
+
+    void root(std::string path) {
+        struct stat st{};
+        if (::stat(path.c_str(), &st) != 0) {
+            error(path);
+            return;
+        }
+        if (S_ISREG(st.st_mode)) {
+            file(st.st_dev, st.st_ino, std::move(path));
+        } else if (S_ISDIR(st.st_mode)) {
+            auto name = path;
+            if (path.back() != '/') path.push_back('/');
+            push({nullptr, std::move(name), std::move(path)});
+        }
+    }
+
+    void run(u_int threads) {
+        std::vector<std::thread> workers;
+        for (u_int i{}; i < std::max(threads, 1u); ++i) workers.emplace_back([this] { worker(); });
+        for (auto &t: workers) t.join();
+    }
+
+    [[nodiscard]] scan_stats_t stats() const { return {files, dirs, duplicates, errors}; }
+
+private:
+    void push(dir_t &&d) {
+        {
+            std::lock_guard lock{mtx};
+            stack.push_back(std::move(d));
+            ++pending;
+        }
+        cv.notify_one();
+    }
+
+    // depth first, so only the directories on the way down keep an fd open for their children
+    void worker() {
+        std::vector<char> buf(64 * 1024);
+        while (true) {
+            std::unique_lock lock{mtx};
+            cv.wait(lock, [this] { return pending == 0 || !stack.empty(); });
+            if (stack.empty()) return;
+            auto d = std::move(stack.back());
+            stack.pop_back();
+            lock.unlock();
+
+            scan_dir(std::move(d), buf);
+
+            lock.lock();
+            if (--pending == 0) cv.notify_all();
+        }
+    }
+
+    void scan_dir(dir_t &&d, std::vector<char> &buf) {
+        const int fd = ::openat(d.parent ? d.parent->fd : AT_FDCWD, d.name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        d.parent.reset();
+        if (fd < 0) {
+            error(d.path);
+            return;
+        }
+        const auto self = std::make_shared<dir_fd_t>(fd);
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) {
+            error(d.path);
+            return;
+        }
+        if (!seen.insert(st.st_dev, st.st_ino)) return; // bind mounts, a root inside another one
+        ++dirs;
+
+        while (true) {
+            const auto n = ::syscall(SYS_getdents64, fd, buf.data(), buf.size());
+            if (n < 0) {
+                error(d.path);
+                return;
+            }
+            if (n == 0) break;
+            for (long pos{}; pos < n;) {
+                const auto *de = reinterpret_cast<const linux_dirent64 *>(buf.data() + pos);
+                pos += de->d_reclen;
+                const char *name = de->d_name;
+                if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) continue;
+
+                auto type = de->d_type;
+                auto ino = static_cast<ino_t>(de->d_ino);
+                auto dev = st.st_dev;
+                if (type == DT_UNKNOWN) { // some filesystems don't fill it in
+                    struct stat est{};
+                    if (::fstatat(fd, name, &est, AT_SYMLINK_NOFOLLOW) != 0) { // symlinks get skipped, as with d_type
+                        error(d.path + name);
+                        continue;
+                    }
+                    if (S_ISREG(est.st_mode)) type = DT_REG;
+                    else if (S_ISDIR(est.st_mode)) type = DT_DIR;
+                    ino = est.st_ino;
+                    dev = est.st_dev;
+                }
+
+                if (type == DT_REG) {
+                    file(dev, ino, d.path + name);
+                } else if (type == DT_DIR) {
+                    push({self, name, d.path + name + '/'});
+                }
+            }
+        }
+    }
+
+    void file(dev_t dev, ino_t ino, std::string &&path) {
+        if (!seen.insert(dev, ino)) {
+            ++duplicates;
+            return;
+        }
+        ++files;
+        cb(std::move(path));
+    }
+
+    void error(const std::string &path) {
+        ++errors;
+        printf("%s: %s\n", path.c_str(), strerror(errno));
+    }
+
+    const std::function<void(std::string &&)> &cb;
+    dev_ino_set_t seen;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<dir_t> stack;
+    size_t pending{}; // on the stack or being read
+
+    std::atomic<size_t> files{};
+    std::atomic<size_t> dirs{};
+    std::atomic<size_t> duplicates{};
+    std::atomic<size_t> errors{};
+};
+
+}
+
+scan_stats_t scan_tree(const std::list<std::string> &roots, u_int threads, const std::function<void(std::string &&)> &cb) {
+    scanner_t scanner{cb};
+    for (const auto &root: roots) scanner.root(root);
+    scanner.run(threads);
+    return scanner.stats();
+}
@@ -0,0 +1,20 @@
+
+#pragma once
+
+#include <functional>
+#include <list>
+#include <string>
+
+#include <sys/types.h>
+
+struct scan_stats_t {
+    size_t files{};
+    size_t dirs{};
+    size_t duplicates{}; // hardlinks, overlapping roots: (device, inode) seen before
+    size_t errors{};
+};
+
+// every regular file under the roots, once per (device, inode), walked by several threads that share a
+// stack of directories. directories are opened relative to their parent's fd and read with getdents64,
+// the inode comes from the dirent so files are never stat'ed here. cb gets called from all the threads
+scan_stats_t scan_tree(const std::list<std::string> &roots, u_int threads, const std::function<void(std::string &&)> &cb);
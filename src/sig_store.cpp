@@ -0,0 +1,288 @@
+
+#include "sig_store.hh"
+
+#include "content_hash.hh"
+#include "extract.hh"
+#include "px.hh"
+#include "tags.hh"
+
+#include <gvs_exception.hh>
+#include <gvs_json_time.hh>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// the grid dims start right after it, version 1 headers end before the hash algorithm
+size_t header_size(uint32_t version) noexcept {
+    return version == 1 ? offsetof(sig_store_t::header_t, hash_algo) : sizeof(sig_store_t::header_t);
+}
+
+}
+
+// record size and where each grid's cells start in it, 8 byte aligned so the records are
+sig_store_t::layout_t::layout_t(std::vector<point_t> grids_): grids{std::move(grids_)} {
+    if (grids.size() > max_grids) throw gvs::exception{"%zu grids, a store holds up to %u", grids.size(), max_grids};
+    record_size = sizeof(record_t);
+    for (const auto &grid: grids) {
+        cell_offs.push_back(record_size);
+        record_size += sig_store_t::cells_size(grid);
+    }
+    record_size = (record_size + 7) & ~size_t{7};
+}
+
+void sig_store_t::layout_t::encode(const gvs::json::val &jv, uint8_t *bytes, const std::optional<point_t> &extract_grid) const {
+    auto &rec = *reinterpret_cast<record_t *>(bytes);
+    const auto put_hash = [&rec](const gvs::json::val &jvh) {
+        const auto digest = jvh.isStr() ? parse_hash(jvh.asStr()) : hash_digest_t{};
+        if (!digest) return false;
+        std::memcpy(rec.sha256, digest.bytes.data(), digest.len);
+        rec.hash_algo = static_cast<uint8_t>(digest.algo);
+        return true;
+    };
+    if (put_hash(jv[tag::hash])) rec.hashed = record_t::full_hash;
+    else if (put_hash(jv[tag::partial])) rec.hashed = record_t::partial_hash;
+    else rec.hashed = record_t::no_hash;
+    if (const auto &jvs = jv[tag::size]; jvs.isInt()) rec.size = jvs.asInt();
+    // records from before the binary store only have the timestamp
+    if (const auto &jvm = jv[tag::mtime]; jvm.isInt()) {
+        rec.mtime_ns = jvm.asInt();
+    } else if (const auto &jvt = jv[tag::timestamp]; jvt.isStr()) {
+        using namespace std::chrono;
+        rec.mtime_ns = duration_cast<nanoseconds>(gvs::json_time::jv2tp(jvt).time_since_epoch()).count();
+    }
+    if (const auto &jvp = jv[tag::phash]; jvp.isStr()) {
+        rec.phash = std::stoull(jvp.asStr(), nullptr, 16);
+        rec.flags |= record_t::has_phash;
+    }
+    for (size_t i{}; i < grids.size(); ++i) {
+        const auto &grid = grids[i];
+        const auto &extracts = jv[tag::extracts][grid_key(grid)];
+        const auto &cells = !extracts.isArr() && extract_grid && *extract_grid == grid ? jv[tag::extract] : extracts;
+        // a grid with cells missing would come back with black ones, it's left for extracting again
+        if (encode_cells(cells, grid, bytes + cell_offs[i])) rec.flags |= record_t::grid_bit(i);
+    }
+}
+
+bool sig_store_t::layout_t::encode_cells(const gvs::json::val &cells, const point_t &grid, uint8_t *out) {
+    if (!cells.isArr()) return false;
+    std::vector<bool> filled(size_t{grid.x} * grid.y);
+    size_t n{};
+    for (const auto &cell: cells.asArr()) {
+        const point_t p{cell[tag::point]};
+        if (p.x >= grid.x || p.y >= grid.y) continue;
+        const px_t px{cell[tag::vals]};
+        const auto c = size_t{p.y} * grid.x + p.x;
+        auto *px_out = out + c * px_t::num_fields;
+        px_out[0] = px.r();
+        px_out[1] = px.g();
+        px_out[2] = px.b();
+        if (!filled[c]) ++n;
+        filled[c] = true;
+    }
+    return n == filled.size();
+}
+
+gvs::json::val sig_store_t::layout_t::decode(const uint8_t *bytes, bool with_cells) const {
+    using namespace std::chrono;
+    const auto &rec = *reinterpret_cast<const record_t *>(bytes);
+    gvs::json::val ret;
+
+    if (rec.hashed != record_t::no_hash) {
+        const auto algo = static_cast<hash_algo_t>(rec.hash_algo);
+        if (const auto len = digest_size(algo); len) {
+            hash_digest_t digest{algo, static_cast<uint8_t>(len)};
+            std::memcpy(digest.bytes.data(), rec.sha256, len);
+            ret[rec.hashed == record_t::full_hash ? tag::hash : tag::partial] = format_hash(digest);
+        }
+    }
+    ret[tag::timestamp] = gvs::json_time::tp2jv(system_clock::time_point{duration_cast<system_clock::duration>(nanoseconds{rec.mtime_ns})});
+    ret[tag::mtime] = static_cast<long>(rec.mtime_ns);
+    ret[tag::size] = static_cast<long>(rec.size);
+
+    for (size_t i{}; with_cells && i < grids.size(); ++i) {
+        if (!(rec.flags & record_t::grid_bit(i))) continue;
+        const auto &grid = grids[i];
+        auto &cells = ret[tag::extracts][grid_key(grid)];
+        const auto *px = bytes + cell_offs[i];
+        for (u_int y{}; y < grid.y; ++y) {
+            for (u_int x{}; x < grid.x; ++x, px += px_t::num_fields) {
+                cells.append(gvs::json::val{gvs::tval{tag::point, point_t{x, y}.to_json()}, gvs::tval{tag::vals, px_t{px, 3}.to_json()}});
+            }
+        }
+    }
+    if (rec.flags & record_t::has_phash) {
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016" PRIx64, rec.phash);
+        ret[tag::phash] = std::string{buf};
+    }
+    return ret;
+}
+
+uint64_t sig_store_t::fnv1a(const char *s) noexcept {
+    uint64_t h{0xcbf29ce484222325ull};
+    for (; *s; ++s) h = (h ^ static_cast<uint8_t>(*s)) * 0x100000001b3ull;
+    return h;
+}
+
+sig_store_t::sig_store_t(const std::string &fn) {
+    const int fd = ::open(fn.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        const auto err = errno;
+        ::close(fd);
+        throw gvs::exception{"%s: %s", fn.c_str(), strerror(err)};
+    }
+    m_size = st.st_size;
+    if (m_size < header_size(1)) {
+        ::close(fd);
+        throw gvs::exception{"%s: not a signature store", fn.c_str()};
+    }
+    auto *map = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) throw gvs::exception{"%s: %s", fn.c_str(), strerror(errno)};
+    m_map = static_cast<const uint8_t *>(map);
+    m_header = reinterpret_cast<const header_t *>(m_map);
+
+    const auto &h = *m_header;
+    const auto dims_off = header_size(h.version);
+    const auto dims_end = dims_off + size_t{h.grids} * sizeof(grid_dims_t);
+    if (std::memcmp(h.magic, magic, sizeof(magic)) != 0 || (h.version != 1 && h.version != version) || h.grids > max_grids ||
+        dims_end > m_size || (h.version != 1 && !digest_size(static_cast<hash_algo_t>(h.hash_algo)))) {
+        ::munmap(const_cast<uint8_t *>(m_map), m_size);
+        throw gvs::exception{"%s: not a signature store", fn.c_str()};
+    }
+    m_hash_algo = h.version == 1 ? hash_algo_t::sha256 : static_cast<hash_algo_t>(h.hash_algo);
+    const auto *dims = reinterpret_cast<const grid_dims_t *>(m_map + dims_off);
+    std::vector<point_t> grids;
+    for (uint32_t i{}; i < h.grids; ++i) grids.emplace_back(dims[i].w, dims[i].h);
+    m_layout = std::make_unique<layout_t>(std::move(grids));
+    if (m_layout->record_size != h.record_size || h.records_off < dims_end || h.records_off + h.records * h.record_size > h.index_off ||
+        !std::has_single_bit(h.index_slots) || h.index_slots <= h.records || h.index_off + h.index_slots * sizeof(uint32_t) > h.strings_off ||
+        h.strings_off + h.strings_size > m_size || (h.strings_size && m_map[h.strings_off + h.strings_size - 1] != 0)) {
+        ::munmap(const_cast<uint8_t *>(m_map), m_size);
+        throw gvs::exception{"%s: damaged signature store", fn.c_str()};
+    }
+    m_index = reinterpret_cast<const uint32_t *>(m_map + h.index_off);
+    m_strings = reinterpret_cast<const char *>(m_map + h.strings_off);
+    ::madvise(const_cast<uint8_t *>(m_map), m_size, MADV_RANDOM);
+}
+
+sig_store_t::~sig_store_t() {
+    ::munmap(const_cast<uint8_t *>(m_map), m_size);
+}
+
+const uint8_t *sig_store_t::cells(const record_t &rec, const point_t &grid) const noexcept {
+    const auto &grids = m_layout->grids;
+    const auto i = static_cast<size_t>(std::find(grids.begin(), grids.end(), grid) - grids.begin());
+    if (i == grids.size() || !(rec.flags & record_t::grid_bit(i))) return nullptr;
+    return reinterpret_cast<const uint8_t *>(&rec) + m_layout->cell_offs[i];
+}
+
+const sig_store_t::record_t *sig_store_t::find(const std::string &path) const noexcept {
+    const auto mask = m_header->index_slots - 1;
+    for (auto i = fnv1a(path.c_str()) & mask; m_index[i]; i = (i + 1) & mask) {
+        const auto n = m_index[i] - 1;
+        if (n >= m_header->records) return nullptr;
+        const auto &rec = (*this)[n];
+        if (rec.path < m_header->strings_size && path == this->path(rec)) return &rec;
+    }
+    return nullptr;
+}
+
+sig_store_t::writer_t::writer_t(const std::string &fn, std::vector<point_t> grids, hash_algo_t algo):
+        m_fn{fn}, m_tmp{fn + ".tmp"}, m_layout{std::move(grids)}, m_algo{algo} {
+    m_fp = ::fopen(m_tmp.c_str(), "w");
+    if (!m_fp) throw gvs::exception{"%s: %s", m_tmp.c_str(), strerror(errno)};
+    // header and dims get written last, the records go straight after them
+    if (::fseek(m_fp, static_cast<long>(sizeof(header_t) + m_layout.grids.size() * sizeof(grid_dims_t) + 7) & ~7L, SEEK_SET) != 0) {
+        const auto err = errno;
+        ::fclose(m_fp);
+        m_fp = nullptr;
+        ::unlink(m_tmp.c_str());
+        throw gvs::exception{"%s: %s", m_tmp.c_str(), strerror(err)};
+    }
+}
+
+sig_store_t::writer_t::~writer_t() {
+    if (!m_fp) return;
+    ::fclose(m_fp);
+    ::unlink(m_tmp.c_str());
+}
+
+void sig_store_t::writer_t::add(const std::string &path, const gvs::json::val &jv, const std::optional<point_t> &extract_grid) {
+    std::vector<uint8_t> buf(m_layout.record_size);
+    m_layout.encode(jv, buf.data(), extract_grid);
+    put(path, buf);
+}
+
+void sig_store_t::writer_t::add(const sig_store_t &from, const record_t &rec) {
+    if (from.grids() != m_layout.grids) {
+        add(from.path(rec), from.to_json(rec));
+        return;
+    }
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&rec);
+    std::vector<uint8_t> buf(bytes, bytes + m_layout.record_size);
+    put(from.path(rec), buf);
+}
+
+void sig_store_t::writer_t::put(const std::string &path, std::vector<uint8_t> &buf) {
+    auto &rec = *reinterpret_cast<record_t *>(buf.data());
+    rec.path = m_strings.size();
+    m_strings.insert(m_strings.end(), path.c_str(), path.c_str() + path.size() + 1);
+    m_hashes.push_back(fnv1a(path.c_str()));
+    if (::fwrite(buf.data(), buf.size(), 1, m_fp) != 1) throw gvs::exception{"%s: %s", m_tmp.c_str(), strerror(errno)};
+    ++m_records;
+}
+
+void sig_store_t::writer_t::finish() {
+    header_t h{};
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.grids = m_layout.grids.size();
+    h.hash_algo = static_cast<uint8_t>(m_algo);
+    h.records = m_records;
+    h.record_size = m_layout.record_size;
+    h.records_off = (sizeof(header_t) + m_layout.grids.size() * sizeof(grid_dims_t) + 7) & ~size_t{7};
+    h.index_off = h.records_off + m_records * m_layout.record_size;
+    h.index_slots = std::bit_ceil(std::max<uint64_t>(m_records * 2, 16));
+    h.strings_off = h.index_off + h.index_slots * sizeof(uint32_t);
+    h.strings_size = m_strings.size();
+
+    std::vector<uint32_t> index(h.index_slots);
+    const auto mask = h.index_slots - 1;
+    for (uint32_t n{}; n < m_records; ++n) {
+        auto i = m_hashes[n] & mask;
+        while (index[i]) i = (i + 1) & mask;
+        index[i] = n + 1;
+    }
+
+    std::vector<grid_dims_t> dims;
+    for (const auto &grid: m_layout.grids) dims.push_back({static_cast<uint16_t>(grid.x), static_cast<uint16_t>(grid.y)});
+
+    const auto ok = ::fwrite(index.data(), sizeof(uint32_t), index.size(), m_fp) == index.size() &&
+                    ::fwrite(m_strings.data(), 1, m_strings.size(), m_fp) == m_strings.size() &&
+                    ::fseek(m_fp, 0, SEEK_SET) == 0 &&
+                    ::fwrite(&h, sizeof(h), 1, m_fp) == 1 &&
+                    (dims.empty() || ::fwrite(dims.data(), sizeof(grid_dims_t), dims.size(), m_fp) == dims.size()) &&
+                    ::fflush(m_fp) == 0 && ::fsync(::fileno(m_fp)) == 0;
+    const auto err = errno;
+    ::fclose(m_fp);
+    m_fp = nullptr;
+    if (!ok || ::rename(m_tmp.c_str(), m_fn.c_str()) != 0) {
+        ::unlink(m_tmp.c_str());
+        throw gvs::exception{"%s: %s", m_fn.c_str(), strerror(ok ? errno : err)};
+    }
+}
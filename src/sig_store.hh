@@ -0,0 +1,152 @@
+
+#pragma once
+
+#include "content_hash.hh"
+#include "point.hh"
+
+#include <gvs_json.hh>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// binary signature store, mapped instead of parsed so opening it costs the same for any number of files:
+//   header | grid dims | fixed size records | path index | path strings
+// a record has the path (offset into the strings), size, mtime, content hash (full or partial, of any algorithm
+// up to 32 bytes), perceptual hash and the cells of
+// every grid in the header, 3 bytes each in row order. the index is open addressing on the path's fnv-1a.
+// the header also has the algorithm new hashes get made with, version 1 stores are from before that and sha256
+class sig_store_t {
+public:
+    static constexpr const char magic[8]{'i', 'm', 'g', 's', 'i', 'g', 's', '\0'};
+    static constexpr const uint32_t version{2};
+    static constexpr const uint32_t max_grids{31}; // a flag bit each, the top one is for the phash
+
+    struct header_t {
+        char magic[8];
+        uint32_t version;
+        uint32_t grids;
+        uint64_t records;
+        uint64_t record_size;
+        uint64_t records_off;
+        uint64_t index_off;
+        uint64_t index_slots; // power of 2, record number + 1, 0 for empty
+        uint64_t strings_off;
+        uint64_t strings_size;
+        uint8_t hash_algo; // a hash_algo_t, not there in version 1
+        uint8_t reserved[7];
+    };
+
+    struct grid_dims_t {
+        uint16_t w, h;
+    };
+
+    struct record_t {
+        static constexpr const uint32_t has_phash{1u << 31};
+        // the flag of header grid i
+        static constexpr uint32_t grid_bit(size_t i) noexcept { return 1u << i; }
+        // what sha256 is of, the stores from before only had full hashes
+        static constexpr const uint8_t full_hash{0}, partial_hash{1}, no_hash{2};
+
+        uint64_t path;
+        uint64_t size;
+        int64_t mtime_ns;
+        uint64_t phash;
+        uint8_t sha256[32];
+        uint32_t flags; // bit i: header grid i is there
+        uint8_t hashed;
+        uint8_t hash_algo; // a hash_algo_t, sha256 in the stores from before
+        uint8_t reserved[2];
+        // cells follow
+    };
+
+    // where a record's cells go for a set of grids, and the conversions to and from json database records
+    struct layout_t {
+        // throws past max_grids
+        explicit layout_t(std::vector<point_t> grids);
+
+        // into record_size zeroed bytes, grids outside these ones or with cells missing are left out. the path is up
+        // to the caller. a single extract from before there were several goes in as extract_grid's cells
+        void encode(const gvs::json::val &jv, uint8_t *rec, const std::optional<point_t> &extract_grid = {}) const;
+        [[nodiscard]] gvs::json::val decode(const uint8_t *rec, bool with_cells = true) const;
+
+        // a json extract of grid into cells_size(grid) zeroed bytes, whether it had every cell
+        static bool encode_cells(const gvs::json::val &cells, const point_t &grid, uint8_t *out);
+
+        std::vector<point_t> grids;
+        std::vector<size_t> cell_offs; // per grid, within a record
+        size_t record_size{};
+    };
+
+    // maps fn, throws if it isn't a store this code wrote
+    explicit sig_store_t(const std::string &fn);
+    ~sig_store_t();
+
+    sig_store_t(const sig_store_t &) = delete;
+    sig_store_t &operator=(const sig_store_t &) = delete;
+
+    [[nodiscard]] size_t size() const noexcept { return m_header->records; }
+    [[nodiscard]] size_t bytes() const noexcept { return m_size; }
+    [[nodiscard]] const std::vector<point_t> &grids() const noexcept { return m_layout->grids; }
+    [[nodiscard]] hash_algo_t hash_algo() const noexcept { return m_hash_algo; }
+
+    [[nodiscard]] const record_t &operator[](size_t i) const noexcept {
+        return *reinterpret_cast<const record_t *>(m_map + m_header->records_off + i * m_header->record_size);
+    }
+
+    [[nodiscard]] const record_t *find(const std::string &path) const noexcept;
+    [[nodiscard]] const char *path(const record_t &rec) const noexcept { return m_strings + rec.path; }
+
+    // the record as it would be in the json database, its grids left out without with_cells
+    [[nodiscard]] gvs::json::val to_json(const record_t &rec, bool with_cells = true) const {
+        return m_layout->decode(reinterpret_cast<const uint8_t *>(&rec), with_cells);
+    }
+
+    // a grid's cells in the record, null if the record or the store doesn't have the grid
+    [[nodiscard]] const uint8_t *cells(const record_t &rec, const point_t &grid) const noexcept;
+
+    // bytes of a grid's cells in a record
+    static size_t cells_size(const point_t &grid) noexcept { return size_t{grid.x} * grid.y * 3; }
+
+    static uint64_t fnv1a(const char *s) noexcept;
+
+    // writes a store to a temporary next to fn and renames it over fn when done, so a store that is
+    // mapped stays intact until then
+    class writer_t {
+    public:
+        writer_t(const std::string &fn, std::vector<point_t> grids, hash_algo_t algo);
+        ~writer_t();
+
+        // a json database record, grids outside the header ones are left out
+        void add(const std::string &path, const gvs::json::val &rec, const std::optional<point_t> &extract_grid = {});
+
+        // a record of another store, copied as-is when the grids are the same
+        void add(const sig_store_t &from, const record_t &rec);
+
+        void finish();
+
+    private:
+        void put(const std::string &path, std::vector<uint8_t> &rec);
+
+        std::string m_fn;
+        std::string m_tmp;
+        layout_t m_layout;
+        hash_algo_t m_algo;
+        FILE *m_fp{};
+        uint64_t m_records{};
+        std::vector<char> m_strings;
+        std::vector<uint64_t> m_hashes; // of the paths, for the index
+    };
+
+private:
+    const uint8_t *m_map{};
+    size_t m_size{};
+    const header_t *m_header{};
+    const char *m_strings{};
+    const uint32_t *m_index{};
+    std::unique_ptr<layout_t> m_layout;
+    hash_algo_t m_hash_algo{};
+};
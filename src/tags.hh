@@ -10,12 +10,17 @@ _(r)             \
 _(g)             \
 _(b)             \
 _(extract)       \
+_(extracts)      \
 _(hash)          \
+_(partial)       \
+_(phash)         \
 _(files)         \
 _(point)         \
 _(vals)          \
 _(grid)          \
 _(timestamp)     \
+_(mtime)         \
+_(size)          \
 
 
 namespace tag {
@@ -0,0 +1,211 @@
+
+#include "uring_reader.hh"
+
+#ifdef IMGPROC_IO_URING
+
+#include <gvs_exception.hh>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <liburing.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// one file on its way through open -> statx -> read..., its slot index is the sqe's user data
+struct request_t {
+    enum step_t { opening, statting, reading };
+
+    uint64_t tag{};
+    std::string fn;
+    step_t step{opening};
+    int fd{-1};
+    struct statx stx{};
+    gvs::dynbuf<uint8_t> bytes;
+    size_t got{};
+    std::chrono::steady_clock::time_point start;
+};
+
+}
+
+struct uring_reader_t::ring_t {
+    struct io_uring ring{};
+    std::vector<request_t> reqs;
+    std::vector<unsigned> free; // slots not in flight
+
+    explicit ring_t(unsigned depth): reqs(depth) {
+        for (auto i = depth; i-- > 0;) free.push_back(i);
+    }
+
+    // every request has one sqe out at a time and the ring has a slot per request, so there's always one
+    io_uring_sqe *sqe(unsigned slot) {
+        auto *ret = io_uring_get_sqe(&ring);
+        if (!ret) throw gvs::exception{"io_uring: no submission slot"};
+        io_uring_sqe_set_data(ret, reinterpret_cast<void *>(static_cast<uintptr_t>(slot)));
+        return ret;
+    }
+
+    void queue(unsigned slot) {
+        auto &r = reqs[slot];
+        switch (r.step) {
+            case request_t::opening:
+                io_uring_prep_openat(sqe(slot), AT_FDCWD, r.fn.c_str(), O_RDONLY | O_CLOEXEC, 0);
+                break;
+            case request_t::statting:
+                io_uring_prep_statx(sqe(slot), r.fd, "", AT_EMPTY_PATH, STATX_SIZE | STATX_TYPE, &r.stx);
+                break;
+            case request_t::reading:
+                io_uring_prep_read(sqe(slot), r.fd, r.bytes.data() + r.got, std::min(r.bytes.size() - r.got, CHUNK), r.got);
+                break;
+        }
+    }
+
+    void finish(unsigned slot, bool ok, const done_t &done) {
+        auto &r = reqs[slot];
+        if (r.fd >= 0) ::close(r.fd);
+        const auto took = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - r.start);
+        std::optional<gvs::dynbuf<uint8_t>> bytes;
+        if (ok) bytes.emplace(std::move(r.bytes));
+        const auto tag = r.tag;
+        r = {};
+        free.push_back(slot);
+        done(tag, std::move(bytes), took);
+    }
+
+    // a step completed with res, queue the next one or hand the file over
+    void advance(unsigned slot, int res, const done_t &done) {
+        auto &r = reqs[slot];
+        if (res == -EINTR || res == -EAGAIN) return queue(slot);
+        if (res < 0) return finish(slot, false, done);
+        switch (r.step) {
+            case request_t::opening:
+                r.fd = res;
+                r.step = request_t::statting;
+                return queue(slot);
+            case request_t::statting:
+                if (!S_ISREG(r.stx.stx_mode)) return finish(slot, false, done);
+                r.bytes = gvs::dynbuf<uint8_t>{static_cast<size_t>(r.stx.stx_size)};
+                if (r.bytes.size() == 0) return finish(slot, true, done);
+                r.step = request_t::reading;
+                return queue(slot);
+            case request_t::reading:
+                if (res == 0) { // shrank since the statx
+                    r.bytes.setsize(r.got);
+                    return finish(slot, true, done);
+                }
+                r.got += res;
+                if (r.got < r.bytes.size()) return queue(slot);
+                return finish(slot, true, done);
+        }
+    }
+};
+
+std::unique_ptr<uring_reader_t> uring_reader_t::open(unsigned depth) {
+    auto ring = std::make_unique<ring_t>(std::max(depth, 1u));
+    // seccomp'd containers and kernels without io_uring refuse the setup
+    if (io_uring_queue_init(ring->reqs.size(), &ring->ring, 0) < 0) return {};
+    std::unique_ptr<uring_reader_t> ret{new uring_reader_t{std::move(ring)}};
+    auto *probe = io_uring_get_probe_ring(&ret->m_ring->ring);
+    const bool supported = probe && io_uring_opcode_supported(probe, IORING_OP_OPENAT) &&
+                           io_uring_opcode_supported(probe, IORING_OP_STATX) && io_uring_opcode_supported(probe, IORING_OP_READ);
+    if (probe) io_uring_free_probe(probe);
+    if (!supported) return {};
+    return ret;
+}
+
+uring_reader_t::~uring_reader_t() {
+    // nothing's left in flight once the read stage is done, only after abandon(). the kernel may still be writing
+    // into those buffers, so they go once their reads complete
+    io_uring_submit(&m_ring->ring);
+    while (in_flight() > 0) {
+        io_uring_cqe *cqe;
+        __kernel_timespec ts{.tv_sec = 30};
+        if (const auto rc = io_uring_wait_cqe_timeout(&m_ring->ring, &cqe, &ts); rc == -EINTR) {
+            continue;
+        } else if (rc != 0) { // a ring that won't answer keeps the buffers it might still write to
+            fprintf(stderr, "io_uring: %zu read(s) never completed\n", in_flight());
+            static_cast<void>(m_ring.release());
+            return;
+        }
+        const auto slot = static_cast<unsigned>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+        const auto res = cqe->res;
+        io_uring_cqe_seen(&m_ring->ring, cqe);
+        // an open that completed has an fd nobody else knows of
+        if (m_ring->reqs[slot].step == request_t::opening && res >= 0) ::close(res);
+        m_ring->finish(slot, false, [](auto...) {});
+    }
+    io_uring_queue_exit(&m_ring->ring);
+}
+
+size_t uring_reader_t::in_flight() const noexcept {
+    return m_ring->reqs.size() - m_ring->free.size();
+}
+
+bool uring_reader_t::full() const noexcept {
+    return m_ring->free.empty();
+}
+
+void uring_reader_t::submit(uint64_t tag, const std::string &fn) {
+    if (full()) throw gvs::exception{"io_uring: %zu reads in flight already", in_flight()};
+    const auto slot = m_ring->free.back();
+    m_ring->free.pop_back();
+    auto &r = m_ring->reqs[slot];
+    r.tag = tag;
+    r.fn = fn;
+    r.start = std::chrono::steady_clock::now();
+    m_ring->queue(slot);
+    if (const auto rc = io_uring_submit(&m_ring->ring); rc < 0) throw gvs::exception{"io_uring submit: %s", strerror(-rc)};
+}
+
+void uring_reader_t::reap(bool wait, const done_t &done) {
+    io_uring_cqe *cqe;
+    int rc;
+    if (wait && in_flight() > 0) {
+        while ((rc = io_uring_wait_cqe(&m_ring->ring, &cqe)) == -EINTR);
+    } else {
+        rc = io_uring_peek_cqe(&m_ring->ring, &cqe);
+    }
+    for (; rc == 0; rc = io_uring_peek_cqe(&m_ring->ring, &cqe)) {
+        const auto slot = static_cast<unsigned>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+        const auto res = cqe->res;
+        io_uring_cqe_seen(&m_ring->ring, cqe);
+        m_ring->advance(slot, res, done);
+    }
+    if (io_uring_sq_ready(&m_ring->ring) > 0) {
+        if (rc = io_uring_submit(&m_ring->ring); rc < 0) throw gvs::exception{"io_uring submit: %s", strerror(-rc)};
+    }
+}
+
+std::vector<uint64_t> uring_reader_t::abandon() const {
+    std::vector<bool> free(m_ring->reqs.size());
+    for (const auto slot: m_ring->free) free[slot] = true;
+    std::vector<uint64_t> ret;
+    for (size_t slot{}; slot < free.size(); ++slot) {
+        if (!free[slot]) ret.push_back(m_ring->reqs[slot].tag);
+    }
+    return ret;
+}
+
+uring_reader_t::uring_reader_t(std::unique_ptr<ring_t> ring) noexcept: m_ring{std::move(ring)} {}
+
+#else
+
+// built without liburing: open() says so and the read stage uses its blocking readers, nothing else gets called
+struct uring_reader_t::ring_t {};
+
+std::unique_ptr<uring_reader_t> uring_reader_t::open(unsigned) { return {}; }
+uring_reader_t::~uring_reader_t() = default;
+size_t uring_reader_t::in_flight() const noexcept { return 0; }
+bool uring_reader_t::full() const noexcept { return true; }
+void uring_reader_t::submit(uint64_t, const std::string &) {}
+void uring_reader_t::reap(bool, const done_t &) {}
+std::vector<uint64_t> uring_reader_t::abandon() const { return {}; }
+uring_reader_t::uring_reader_t(std::unique_ptr<ring_t> ring) noexcept: m_ring{std::move(ring)} {}
+
+#endif
@@ -0,0 +1,51 @@
+
+#pragma once
+
+#include <gvs_dynbuf.hh>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// whole files read through io_uring, up to depth of them in flight from a single thread: each file's open,
+// statx and reads get queued one after the other as the previous step completes, so it's the queue depth that
+// covers the disk or network latency rather than threads blocked in read(2). there only when built with
+// IMGPROC_IO_URING and the kernel has the opcodes, not thread safe
+class uring_reader_t {
+public:
+    // a finished file: its bytes, nothing if it couldn't be read, and how long that took from submit()
+    using done_t = std::function<void(uint64_t tag, std::optional<gvs::dynbuf<uint8_t>> &&bytes, std::chrono::microseconds took)>;
+
+    // the most a single read asks for, a bigger file carries on where the last one stopped as after a short read
+    static constexpr const size_t CHUNK{1 << 20};
+
+    // nothing if io_uring isn't available, in this build or this kernel
+    static std::unique_ptr<uring_reader_t> open(unsigned depth);
+    ~uring_reader_t();
+
+    uring_reader_t(const uring_reader_t &) = delete;
+    uring_reader_t &operator=(const uring_reader_t &) = delete;
+
+    [[nodiscard]] size_t in_flight() const noexcept;
+    [[nodiscard]] bool full() const noexcept;
+
+    // start reading a file, not while full()
+    void submit(uint64_t tag, const std::string &fn);
+
+    // move the reads along and hand over the files that are done, after waiting for at least one if wait
+    void reap(bool wait, const done_t &done);
+
+    // the files in flight, for when submit() or reap() threw: nothing is reported for them after this, and
+    // nothing is left to do with the reader but destroy it. that waits for the kernel to let go of their buffers
+    [[nodiscard]] std::vector<uint64_t> abandon() const;
+
+private:
+    struct ring_t;
+    explicit uring_reader_t(std::unique_ptr<ring_t> ring) noexcept;
+    std::unique_ptr<ring_t> m_ring;
+};
@@ -18,8 +18,8 @@
 namespace {
 
 struct finfo_t {
-    finfo_t(g::string_ptr fn, size_t fs, point_t point): name{std::move(fn)}, size{fs}, point{point} {}
-    g::string_ptr name;
+    finfo_t(std::string fn, size_t fs, point_t point): name{std::move(fn)}, size{fs}, point{point} {}
+    std::string name;
     size_t size;
     point_t point;
 };
@@ -58,8 +58,8 @@ void user_action_r(std::string input, dupfiles_t &dupfiles) {
     const auto from = std::stoi(fields[1]);
     const auto to = std::stoi(fields[2]);
     if (from < 0 || from >= dupfiles.size() || to < 0 || to >= dupfiles.size()) return;
-    const auto &ff = *dupfiles[from].name;
-    const auto &tf = *dupfiles[to].name;
+    const auto &ff = dupfiles[from].name;
+    const auto &tf = dupfiles[to].name;
     if (fields.size() < 4 || fields[3] != "y"s) {
         printf("rename '%s' to '%s'?\ny/n?: ", ff.c_str(), tf.c_str());
         std::getline(std::cin, input);
@@ -76,7 +76,7 @@ action_t user_action_ads(std::string input, fields_t &fields, dupfiles_t &dupfil
     const auto dirno = std::stoi(fields[1]);
     const auto max_cluster_size = (fields.size() > 2) ? std::stoi(fields[2]) : 100000;
     if (dirno < 0 || dirno >= dupfiles.size()) return nullptr;
-    auto dirname = gvs::utl::dirname(*dupfiles[dirno].name);
+    auto dirname = gvs::utl::dirname(dupfiles[dirno].name);
     printf("autodelete outside '%s' same size max cluster sz %d?\ny/n?: ", dirname.c_str(), max_cluster_size);
     std::getline(std::cin, input);
     if (input.size() == 1 && input[0] == 'y') {
@@ -85,7 +85,7 @@ action_t user_action_ads(std::string input, fields_t &fields, dupfiles_t &dupfil
 
             size_t sz{}; // find size if it's unique
             for (const auto &f: dupfiles) {
-                if (gvs::utl::dirname(*f.name) == dn) {
+                if (gvs::utl::dirname(f.name) == dn) {
                     if (sz != 0) return nullptr;
                     sz = f.size;
                 }
@@ -95,9 +95,9 @@ action_t user_action_ads(std::string input, fields_t &fields, dupfiles_t &dupfil
             auto [min_sz, max_sz] = std::make_tuple(.0, dsz + dsz * .1);
 
             for (const auto &f: dupfiles) {
-                if (gvs::utl::dirname(*f.name) != dn && min_sz < f.size && f.size < max_sz) {
-                    if (0 == ::unlink(f.name->c_str())) {
-                        printf("delete '%s'\n", f.name->c_str());
+                if (gvs::utl::dirname(f.name) != dn && min_sz < f.size && f.size < max_sz) {
+                    if (0 == ::unlink(f.name.c_str())) {
+                        printf("delete '%s'\n", f.name.c_str());
                     }
                 }
             }
@@ -116,10 +116,10 @@ void user_action_v(gvs::exec &executor, fields_t &fields, dupfiles_t &dupfiles)
         for (const auto &f: fields) {
             try {
                 int i = std::stoi(f);
-                if (i >= 0 && i < dupfiles.size()) eargs.emplace_back(*dupfiles[i].name);
+                if (i >= 0 && i < dupfiles.size()) eargs.emplace_back(dupfiles[i].name);
             } catch (...) {}
         }
-    } else for (const auto &fn: dupfiles) eargs.emplace_back(*fn.name);
+    } else for (const auto &fn: dupfiles) eargs.emplace_back(fn.name);
     const auto[st, o, e] = gvs::exec_task{executor(eargs)}();
 }
 
@@ -142,7 +142,7 @@ action_t user_action(gvs::exec &executor, dupfiles_t &dupfiles) {
         std::cout << "- - - - - - - - - - - - -";
         int i{};
         for (const auto &fi: dupfiles) {
-            printf("\n%d: '%s' %dx%d %.2f MiB", i++, fi.name->c_str(), fi.point.x, fi.point.y, static_cast<double>(fi.size) / 1024. / 1024.);
+            printf("\n%d: '%s' %dx%d %.2f MiB", i++, fi.name.c_str(), fi.point.x, fi.point.y, static_cast<double>(fi.size) / 1024. / 1024.);
         }
         std::cout << "\n- - - - - - - - - - - - -" << help_line;
 
@@ -187,18 +187,18 @@ action_t user_action(gvs::exec &executor, dupfiles_t &dupfiles) {
             case 'd': {
                 if (fields.size() == 1 && fields[0] == "da"s) {
                     for (auto it = dupfiles.begin(); it != dupfiles.end();) {
-                        if (0 == ::unlink(it->name->c_str())) it = dupfiles.erase(it);
+                        if (0 == ::unlink(it->name.c_str())) it = dupfiles.erase(it);
                         else ++it;
                     }
                 } else if (fields.size() > 1 && fields[0] == "d"s) {
-                    std::set<g::string_ptr> to_delete; // collect all the files into this so duipfiles indeces don't change
+                    std::set<std::string> to_delete; // collect all the files into this so duipfiles indeces don't change
                     for (auto fit = fields.cbegin() + 1; fit != fields.cend(); ++fit) {
                         try {
                             if (int num = std::stoi(*fit); num >= 0 && num < dupfiles.size()) to_delete.emplace(dupfiles[num].name);
                         } catch (...) {}
                     }
                     for (auto it = dupfiles.begin(); it != dupfiles.end(); ) {
-                        if (gvs::utl::container_contains(to_delete, it->name) && 0 == ::unlink(it->name->c_str())) it = dupfiles.erase(it);
+                        if (gvs::utl::container_contains(to_delete, it->name) && 0 == ::unlink(it->name.c_str())) it = dupfiles.erase(it);
                         else ++it;
                     }
                 }
@@ -215,7 +215,7 @@ action_t user_action(gvs::exec &executor, dupfiles_t &dupfiles) {
 
 };
 
-int deal_with_duplicates(gvs::exec &executor, std::list<std::shared_ptr<std::string>> &&bad_files, std::list<std::set<std::shared_ptr<std::string>>> &&clusters) {
+int deal_with_duplicates(gvs::exec &executor, std::list<file_id_t> &&bad_files, std::list<std::set<file_id_t>> &&clusters) {
     using namespace std::string_literals;
 
     if (!bad_files.empty()) {
@@ -229,14 +229,14 @@ int deal_with_duplicates(gvs::exec &executor, std::list<std::shared_ptr<std::str
                 case 'l':
                     std::cout << "\n-------------\n";
                     for (const auto &f: bad_files) {
-                        std::cout << "'" << *f << "'" << std::endl;
+                        std::cout << "'" << g::files.path(f) << "'" << std::endl;
                     }
                     std::cout << "-------------\n";
                     break;
                 case 'd': {
                     std::cout << "\n";
                     for (auto it = bad_files.begin(); it != bad_files.end();) {
-                        const auto &fn = **it;
+                        const auto fn = g::files.path(*it);
                         if (0 == ::unlink(fn.c_str())) {
                             std::cout << "Deleted '" << fn << "'\n";
                         } else {
@@ -261,11 +261,12 @@ int deal_with_duplicates(gvs::exec &executor, std::list<std::shared_ptr<std::str
             try {
                 printf("\n%ld clusters(s) to go...\n", clusters.size());
                 std::vector<finfo_t> dupfiles;
-                for (const auto &fn: *clit) {
+                for (const auto id: *clit) {
                     try {
-                        auto point = read_img_header(*fn);
-                        if (!point) dupfiles.emplace_back(fn, gvs::utl::statx(*fn).st_size, point_t{0, 0});
-                        else dupfiles.emplace_back(fn, gvs::utl::statx(*fn).st_size, *point);
+                        auto fn = g::files.path(id);
+                        auto point = read_img_header(fn);
+                        const auto size = gvs::utl::statx(fn).st_size;
+                        dupfiles.emplace_back(std::move(fn), size, point ? *point : point_t{0, 0});
                     } catch (const std::exception &ex) {
                         std::cout << ex.what() << std::endl;
                     }
@@ -2,13 +2,20 @@
 #include "utils.hh"
 
 #include "globals.hh"
+#include "grid.hh"
+#include "input_buf.hh"
+#include "scanline_sink.hh"
 
 #include <gvs_defer.hh>
 #include <gvs_dynbuf.hh>
 #include <gvs_timer.hh>
 #include <gvs_utils.hh>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <tuple>
+#include <vector>
 
 #include <jpeglib.h>
 #include <png.h>
@@ -16,7 +23,7 @@
 namespace {
 
 struct png_mem_read_st {
-    gvs::dynbuf<uint8_t> *mem{};
+    const input_buf_t *mem{};
     size_t pos{8}; // skip header
 };
 
@@ -50,15 +57,15 @@ void jpeg_emit_message(j_common_ptr cinfo, int lvl) {
     }
 };
 
-std::optional<bmp_t> do_png(gvs::dynbuf<uint8_t> *mem, const std::string &fn) {
+bool do_png(const input_buf_t *mem, const std::string &fn, scanline_sink_t &sink) {
     /* initialize stuff */
     try {
         auto *pngp = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, png_error_fn, png_warning_fn);
-        if (!pngp) return {};
+        if (!pngp) return false;
         auto png_free = gvs::defer([&pngp] { png_destroy_read_struct(&pngp, nullptr, nullptr); });
 
         auto *infop = png_create_info_struct(pngp);
-        if (!infop) return {};
+        if (!infop) return false;
         auto info_free = gvs::defer([&pngp, &infop] { png_destroy_info_struct(pngp, &infop); });
 
         png_mem_read_st read_st{.mem = mem};
@@ -93,6 +100,7 @@ std::optional<bmp_t> do_png(gvs::dynbuf<uint8_t> *mem, const std::string &fn) {
                 break;
         }
 
+        const auto passes = png_set_interlace_handling(pngp);
         png_read_update_info(pngp, infop);
 
         auto width = png_get_image_width(pngp, infop);
@@ -102,19 +110,29 @@ std::optional<bmp_t> do_png(gvs::dynbuf<uint8_t> *mem, const std::string &fn) {
         const auto rowlen = png_get_rowbytes(pngp, infop);
 //    printf("png %dx%d %d %d, %ld\n", width, height, color_type, bit_depth, rowlen/width);
 
-        bmp_t bmp{width, height, static_cast<u_int>(rowlen / width)};
-
-        gvs::dynbuf<png_bytep> rows{height};
-        for (int y{}; y < height; ++y) rows[y] = bmp.row(y);
+        sink.begin(width, height, static_cast<u_int>(rowlen / width));
 
         if (setjmp(png_jmpbuf(pngp))) throw gvs::exception{"[read_png_file] Error during read_image"};
-        png_read_image(pngp, rows.data());
+        if (passes > 1) { // interlaced - every pass touches every row, so it needs the whole image
+            gvs::dynbuf<uint8_t> img{height * rowlen};
+            gvs::dynbuf<png_bytep> rows{height};
+            for (int y{}; y < height; ++y) rows[y] = sink.row_buf(y) ?: img.data() + y * rowlen;
+            png_read_image(pngp, rows.data());
+            for (int y{}; y < height; ++y) sink.rows(y, rows[y], 1, rowlen);
+        } else {
+            gvs::dynbuf<uint8_t> scratch{rowlen};
+            for (u_int y{}; y < height; ++y) {
+                auto *row = sink.row_buf(y) ?: scratch.data();
+                png_read_row(pngp, row, nullptr);
+                sink.rows(y, row, 1, rowlen);
+            }
+        }
 
-        return {std::move(bmp)};
+        return true;
     } catch (const std::exception &ex) {
         fprintf(stderr, "%s: %s\n", fn.c_str(), ex.what());
     }
-    return {};
+    return false;
 }
 
 std::optional<point_t> do_png_header(const std::string &fn) {
@@ -146,7 +164,20 @@ std::optional<point_t> do_png_header(const std::string &fn) {
     return {};
 }
 
-std::optional<bmp_t> do_jpeg(gvs::dynbuf<uint8_t> *mem, const std::string &fn) {
+// smallest DCT scale (1/8, 1/4, 1/2) that still leaves MIN_CELL_SIDE pixels per cell side of every grid extracted
+u_int jpeg_scale_denom(u_int w, u_int h) noexcept {
+    u_int cols{g::grid_w}, rows{g::grid_h};
+    for (const auto &grid: g::extract_grids) {
+        cols = std::max(cols, grid.x);
+        rows = std::max(rows, grid.y);
+    }
+    for (const u_int denom: {8U, 4U, 2U}) {
+        if (w / denom >= cols * g::MIN_CELL_SIDE && h / denom >= rows * g::MIN_CELL_SIDE) return denom;
+    }
+    return 1;
+}
+
+bool do_jpeg(const input_buf_t *mem, const std::string &fn, scanline_sink_t &sink) {
     jpeg_error_mgr jerr;
     jpeg_decompress_struct cinfo{.err = jpeg_std_error(&jerr)};
     jerr.error_exit = jpeg_error_exit;
@@ -154,22 +185,39 @@ std::optional<bmp_t> do_jpeg(gvs::dynbuf<uint8_t> *mem, const std::string &fn) {
 
     try {
         jpeg_create_decompress(&cinfo);
-        auto freeer = [ptr = &cinfo] { jpeg_destroy_decompress(ptr); };
+        auto freeer = gvs::defer([ptr = &cinfo] { jpeg_destroy_decompress(ptr); });
         // Variables for the decompressor itself
         jpeg_mem_src(&cinfo, mem->data(), mem->size());
         jpeg_read_header(&cinfo, true);
+        if (g::scaled_decode) {
+            cinfo.scale_num = 1;
+            cinfo.scale_denom = jpeg_scale_denom(cinfo.image_width, cinfo.image_height);
+        }
         jpeg_start_decompress(&cinfo);
         switch (cinfo.output_components) {
             case 3:
             case 1: {
-                bmp_t bmp{cinfo.output_width, cinfo.output_height, static_cast<u_int>(cinfo.output_components)};
+                sink.begin(cinfo.output_width, cinfo.output_height, static_cast<u_int>(cinfo.output_components));
+                // libjpeg hands out up to rec_outbuf_height (at most 4) rows per call
+                const size_t stride = cinfo.output_width * cinfo.output_components;
+                const u_int batch = std::clamp(cinfo.rec_outbuf_height, 1, 4);
+                gvs::dynbuf<uint8_t> scratch{batch * stride};
                 while (cinfo.output_scanline < cinfo.output_height) {
-                    unsigned char *barr[1]{bmp.row(cinfo.output_scanline)};
-                    jpeg_read_scanlines(&cinfo, barr, 1);
+                    const auto y = cinfo.output_scanline;
+                    if (auto *row = sink.row_buf(y); row) {
+                        unsigned char *barr[1]{row};
+                        jpeg_read_scanlines(&cinfo, barr, 1);
+                        sink.rows(y, row, 1, stride);
+                    } else {
+                        unsigned char *barr[4];
+                        for (u_int i{}; i < batch; ++i) barr[i] = scratch.data() + i * stride;
+                        const auto cnt = jpeg_read_scanlines(&cinfo, barr, batch);
+                        sink.rows(y, scratch.data(), cnt, stride);
+                    }
                 }
                 jpeg_finish_decompress(&cinfo);
 
-                return {std::move(bmp)};
+                return true;
             }
 
             default:
@@ -179,6 +227,88 @@ std::optional<bmp_t> do_jpeg(gvs::dynbuf<uint8_t> *mem, const std::string &fn) {
         fprintf(stderr, "%s: %s\n", fn.c_str(), ex.what());
     }
 
+    return false;
+}
+
+// per-cell YCbCr (or gray) averages from the 8x8 block DC terms - no IDCT, no upsampling, no bmp
+std::optional<g::multigrid_t> do_jpeg_dc(const input_buf_t *mem, const std::string &fn) {
+    jpeg_error_mgr jerr;
+    jpeg_decompress_struct cinfo{.err = jpeg_std_error(&jerr)};
+    jerr.error_exit = jpeg_error_exit;
+    jerr.emit_message = jpeg_emit_message;
+
+    try {
+        jpeg_create_decompress(&cinfo);
+        auto freeer = gvs::defer([ptr = &cinfo] { jpeg_destroy_decompress(ptr); });
+        jpeg_mem_src(&cinfo, mem->data(), mem->size());
+        jpeg_read_header(&cinfo, true);
+
+        // only the colorspaces with a known linear mapping to rgb
+        if (!(cinfo.jpeg_color_space == JCS_YCbCr && cinfo.num_components == 3) &&
+            !(cinfo.jpeg_color_space == JCS_GRAYSCALE && cinfo.num_components == 1)) return {};
+
+        const auto coefs = jpeg_read_coefficients(&cinfo);
+
+        struct cell_t {
+            double sum[3]{};
+            double weight[3]{};
+        };
+        typedef std::unordered_map<point_t, cell_t, point_hash> cells_t;
+        std::vector<std::tuple<grid_t, cells_t>> grids;
+        for (const auto &gr: g::extract_grids) grids.emplace_back(grid_t{gr.x, gr.y, cinfo.image_width, cinfo.image_height}, cells_t{});
+
+        for (int c{}; c < cinfo.num_components; ++c) {
+            const auto *comp = cinfo.comp_info + c;
+            if (!comp->quant_table) return {};
+            const double q0 = comp->quant_table->quantval[0];
+            // image pixels covered by one block of this component
+            const u_int bw = 8 * cinfo.max_h_samp_factor / comp->h_samp_factor;
+            const u_int bh = 8 * cinfo.max_v_samp_factor / comp->v_samp_factor;
+
+            for (JDIMENSION by{}; by < comp->height_in_blocks; ++by) {
+                const u_int y0 = by * bh;
+                if (y0 >= cinfo.image_height) break;
+                const u_int y1 = std::min(y0 + bh, cinfo.image_height);
+                const auto rows = (*cinfo.mem->access_virt_barray)((j_common_ptr) &cinfo, coefs[c], by, 1, false);
+                for (JDIMENSION bx{}; bx < comp->width_in_blocks; ++bx) {
+                    const u_int x0 = bx * bw;
+                    if (x0 >= cinfo.image_width) break;
+                    const u_int x1 = std::min(x0 + bw, cinfo.image_width);
+                    // DC is 8x the mean of the level shifted block samples
+                    const auto mean = rows[0][bx][0] * q0 / 8. + 128.;
+                    const double weight = (x1 - x0) * (y1 - y0);
+                    for (auto &[gridder, cells]: grids) {
+                        auto &cell = cells[gridder({(x0 + x1) / 2, (y0 + y1) / 2})];
+                        cell.sum[c] += mean * weight;
+                        cell.weight[c] += weight;
+                    }
+                }
+            }
+        }
+        jpeg_finish_decompress(&cinfo);
+
+        auto clamp = [](double v) { return static_cast<int>(std::round(std::clamp(v, 0., 255.))); };
+        g::multigrid_t ret;
+        for (const auto &[gridder, cells]: grids) {
+            auto &avgs = ret[{gridder.m_gw, gridder.m_gh}];
+            for (const auto &[p, cell]: cells) {
+                if (cinfo.num_components == 1) {
+                    const auto y = clamp(cell.sum[0] / cell.weight[0]);
+                    avgs.emplace(p, px_t{y, y, y});
+                } else {
+                    if (!cell.weight[0] || !cell.weight[1] || !cell.weight[2]) return {};
+                    const auto y = cell.sum[0] / cell.weight[0];
+                    const auto cb = cell.sum[1] / cell.weight[1] - 128.;
+                    const auto cr = cell.sum[2] / cell.weight[2] - 128.;
+                    avgs.emplace(p, px_t{clamp(y + 1.402 * cr), clamp(y - 0.344136 * cb - 0.714136 * cr), clamp(y + 1.772 * cb)});
+                }
+            }
+        }
+        return {std::move(ret)};
+    } catch (const std::exception &ex) {
+        fprintf(stderr, "%s: %s\n", fn.c_str(), ex.what());
+    }
+
     return {};
 }
 
@@ -205,21 +335,51 @@ std::optional<point_t> do_jpeg_header(const std::string &fn) {
     return {};
 }
 
+// decodes straight into a bmp_t
+struct bmp_sink_t final: scanline_sink_t {
+    void begin(u_int w, u_int h, u_int pxs) override { bmp.set(w, h, pxs); }
+    uint8_t *row_buf(u_int y) override { return bmp.row(y); }
+    void rows(u_int, const uint8_t *, u_int, size_t) override {}
+    bmp_t bmp;
+};
+
+}
+
+// with mmap the pages are only faulted in while decoding, so the read time here is just the mapping
+input_buf_t read_input(const std::string &fn) {
+    gvs::timer timer;
+    input_buf_t buf{fn, g::use_mmap};
+    g::read_avgs.w([&buf, &timer] (auto &z) {
+        z.sz += buf.size();
+        ++z.cnt;
+        z.dur += timer.dur<std::chrono::milliseconds>();
+    });
+    return buf;
 }
 
-std::optional<bmp_t> read_img(const std::string &fn) {
+bool read_img(const input_buf_t &buf, const std::string &fn, scanline_sink_t &sink) {
     try {
-        gvs::timer timer;
-        auto buf = gvs::utl::read_file<gvs::dynbuf<uint8_t>>(fn, 100);
-        g::read_avgs.w([&buf, &timer] (auto &z) {
-            z.sz += buf.size();
-            ++z.cnt;
-            z.dur += timer.dur<std::chrono::milliseconds>();
-        });
-
-        if (buf.size() < 128) return {};
-        if (!png_sig_cmp(buf.data(), 0, 8)) return do_png(&buf, fn);
-        return do_jpeg(&buf, fn);
+        if (buf.size() < 128) return false;
+        if (!png_sig_cmp(buf.data(), 0, 8)) return do_png(&buf, fn, sink);
+        return do_jpeg(&buf, fn, sink);
+    }
+    catch (const gvs::exception &ex) {
+        fprintf(stderr, "%s: %s\n", fn.c_str(), ex.what());
+    }
+
+    return false;
+}
+
+std::optional<bmp_t> read_img(const input_buf_t &buf, const std::string &fn) {
+    bmp_sink_t sink;
+    if (!read_img(buf, fn, sink)) return {};
+    return {std::move(sink.bmp)};
+}
+
+std::optional<g::multigrid_t> read_img_dc(const input_buf_t &buf, const std::string &fn) {
+    try {
+        if (buf.size() < 128 || !png_sig_cmp(buf.data(), 0, 8)) return {};
+        return do_jpeg_dc(&buf, fn);
     }
     catch (const gvs::exception &ex) {
         fprintf(stderr, "%s: %s\n", fn.c_str(), ex.what());
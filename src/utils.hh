@@ -2,12 +2,24 @@
 #pragma once
 
 #include "bmp.hh"
+#include "globals.hh"
+#include "input_buf.hh"
 #include "point.hh"
+#include "scanline_sink.hh"
 
 #include <optional>
 #include <string>
 
-std::optional<bmp_t> read_img(const std::string &fn);
+// the file's bytes, read or mapped as configured and counted in read_avgs
+input_buf_t read_input(const std::string &fn);
+
+std::optional<bmp_t> read_img(const input_buf_t &buf, const std::string &fn);
+
+// decode pushing rows into the sink as they come, false for bad files
+bool read_img(const input_buf_t &buf, const std::string &fn, scanline_sink_t &sink);
+
+// extract_grids averages from the jpeg DC coefficients, empty if the file is not a YCbCr/gray jpeg
+std::optional<g::multigrid_t> read_img_dc(const input_buf_t &buf, const std::string &fn);
 
 std::optional<point_t> read_img_header(const std::string &fn);
 
@@ -2,20 +2,35 @@
 #include "worker_thread.hh"
 
 #include "bmp_averager.hh"
+#include "content_hash.hh"
+#include "exact_dups.hh"
+#include "extract.hh"
 #include "globals.hh"
-#include "grid.hh"
+#include "matcher.hh"
+#include "phash.hh"
 #include "point.hh"
 #include "tags.hh"
+#include "uring_reader.hh"
 #include "utils.hh"
 
-#include <gvs_hash.hh>
+#include <gvs_defer.hh>
+#include <gvs_exception.hh>
 #include <gvs_json_time.hh>
 #include <gvs_timer.hh>
 #include <gvs_utils.hh>
 
+#include <algorithm>
+#include <cinttypes>
 #include <cmath>
+#include <cstdio>
+#include <optional>
 #include <set>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
 
 namespace {
 
@@ -24,205 +39,424 @@ auto from_ts(struct timespec ts) noexcept {
     return seconds{ts.tv_sec} + nanoseconds{ts.tv_nsec} + system_clock::from_time_t(0);
 }
 
-void hash_loop() {
-    using namespace std::chrono_literals;
-    int recalculated{};
+long mtime_ns(struct timespec ts) noexcept { return ts.tv_sec * 1'000'000'000L + ts.tv_nsec; }
+
+// a record as of a file's stat, the rest of it left to f
+template <typename F>
+void stamp(gvs::json::val &jv, const g::stated_t &file, const F &f) {
+    f(jv);
+    if (auto &jvt = jv[tag::timestamp], mtime = gvs::json_time::tp2jv(from_ts(file.mtime)); jvt != mtime) {
+        jvt = std::move(mtime);
+        ++g::db_recalcs;
+    }
+    jv[tag::mtime] = mtime_ns(file.mtime);
+    jv[tag::size] = static_cast<long>(file.size);
+}
+
+// a grid's cells as the db has them, empty if the record doesn't have them all
+g::pointwithavg_t stored_cells(const std::string &fn, const point_t &grid) {
+    g::pointwithavg_t ret;
+    const auto cells = g::database.cells(fn, grid);
+    if (cells.empty()) return ret;
+    const auto *px = cells.data();
+    for (u_int y{}; y < grid.y; ++y) {
+        for (u_int x{}; x < grid.x; ++x, px += px_t::num_fields) ret.emplace(point_t{x, y}, px_t{px, px_t::num_fields});
+    }
+    return ret;
+}
+
+// perceptual hash as stored, or worked out from the stored 16x16 grid
+std::optional<uint64_t> stored_phash(const std::string &fn) {
+    if (auto ret = g::database.phash(fn); ret) return ret;
+    const auto grid = stored_cells(fn, {PHASH_GRID, PHASH_GRID});
+    if (grid.empty()) return {};
+    return phash(grid);
+}
+
+std::string phash_str(uint64_t h) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016" PRIx64, h);
+    return buf;
+}
+
+// extract every grid and store them, the file is read unless its bytes are at hand. nothing for bad files
+std::optional<g::indexed_t> recalc_file(file_id_t id, const std::string &fn, const input_buf_t *buf) {
+    ++g::db_recalcs;
+    gvs::timer timer;
+    const auto ext = buf ? extract(*buf, fn) : extract(fn);
+    if (!ext) {
+        g::bad_files.w([id](auto &z) { z.emplace_back(id); });
+        g::database.remove(fn);
+        return {};
+    }
+
+    gvs::json::val extracts_jv;
+    for (const auto &[grid, avgs]: ext->grids) { // save the avgs as-is, every grid
+        auto &extract_jv = extracts_jv[grid_key(grid)];
+        for (const auto &[p, px]: avgs) {
+            extract_jv.append(gvs::json::val{gvs::tval{tag::point, p.to_json()}, gvs::tval{tag::vals, px.to_json()}});
+        }
+    }
+    g::indexed_t ret{.id = id};
+    ret.grid = ext->grids.at({g::grid_w, g::grid_h}); // the palette gets reduced for the lookups, not here
+    if (const auto it = ext->grids.find({PHASH_GRID, PHASH_GRID}); it != ext->grids.end()) ret.phash = phash(it->second);
+    g::database.w(fn, [&extracts_jv, &ret](auto &jv) {
+        jv[tag::extracts] = std::move(extracts_jv);
+        jv.remove(tag::extract);
+        if (ret.phash) jv[tag::phash] = phash_str(*ret.phash);
+        else jv.remove(tag::phash);
+    });
+
+    g::proc_avgs.w([&ext, &timer](auto &z) {
+        ++z.recalc;
+        ++z.cnt;
+        z.sz += ext->bytes;
+        z.dur += timer.dur<std::chrono::milliseconds>();
+    });
+    return ret;
+}
+
+// this run's grid and the perceptual hash from the db record, throws if it is not usable
+g::indexed_t stored_file(file_id_t id, const std::string &fn) {
+    gvs::timer timer;
+    g::indexed_t ret{.id = id, .grid = stored_cells(fn, {g::grid_w, g::grid_h})};
+    if (ret.grid.empty()) throw gvs::exception{"%s: no %ux%u grid stored", fn.c_str(), g::grid_w, g::grid_h};
+    if (g::phash_dist >= 0) ret.phash = stored_phash(fn);
+    g::proc_avgs.w([&timer](auto &z) {
+        ++z.cnt;
+        z.dur += timer.dur<std::chrono::milliseconds>();
+    });
+    return ret;
+}
+
+// whether a touched file still has the content its record's full hash was made of, and the hash, made with that
+// hash's algorithm from the file's bytes if they're at hand. the record gets the file's stamps either way, it
+// starts over with the new hash if the content changed. throws if the file can't be read
+std::pair<bool, std::string> same_content(const g::stated_t &file, const std::string &fn, const input_buf_t *buf) {
+    gvs::timer timer;
+    const auto stored_hash = g::database.head(fn, [](const auto &z) { return z[tag::hash].isStr() ? z[tag::hash].asStr() : std::string{}; });
+    const auto algo = stored_hash.empty() ? g::content_algo : stored_algo(stored_hash);
+    auto hash = buf ? content_hash(algo, buf->data(), buf->size()) : file_hash(algo, fn);
+    const auto same = hash == stored_hash;
+    g::database.w(fn, [&file, &hash, same](auto &jv) {
+        stamp(jv, file, [&hash, same](auto &jv) {
+            if (same) return;
+            jv.clear();
+            jv[tag::hash] = hash;
+            ++g::db_recalcs;
+        });
+    });
+    g::hash_avgs.w([&timer, same](auto &z) {
+        ++z.cnt;
+        if (!same) ++z.recalc;
+        z.dur += timer.dur<std::chrono::milliseconds>();
+    });
+    return {same, std::move(hash)};
+}
+
+// keeps a hash exact duplicate detection worked out in the file's record, if the record is of the file as it is
+// now, for the next run to start from. a full hash takes the place of a partial one and of a full one made with
+// another algorithm, so the records come over to the store's algorithm as their files get hashed
+void keep_hash(const std::string &fn, exact_dups_t::stage_t stage, const std::string &hash) {
+    struct stat st;
+    try {
+        st = gvs::utl::statx(fn);
+    } catch (...) {
+        return;
+    }
+    g::database.update(fn, [&st, stage, &hash](auto &jv) {
+        const auto &z = std::as_const(jv); // looking doesn't add anything
+        if (!z[tag::mtime].isInt() || z[tag::mtime].asInt() != mtime_ns(st.st_mtim) || z[tag::size].asInt() != st.st_size) return false;
+        const auto &jvh = z[tag::hash];
+        if (jvh.isStr() && stage != exact_dups_t::by_full) return false;
+        if (stage == exact_dups_t::by_full) {
+            if (jvh.isStr() && jvh.asStr() == hash) return false;
+            jv[tag::hash] = hash;
+            jv.remove(tag::partial);
+            return true;
+        }
+        if (const auto &jvp = z[tag::partial]; jvp.isStr() && jvp.asStr() == hash) return false;
+        jv[tag::partial] = hash;
+        return true;
+    });
+}
 
-    while (true) {
+// a file's hash for a stage of exact duplicate detection, kept in its record. nothing if it can't be read
+std::optional<std::string> stage_hash(file_id_t id, exact_dups_t::stage_t stage) {
+    const auto fn = g::files.path(id);
+    try {
+        gvs::timer timer;
+        const auto whole = stage == exact_dups_t::by_full;
+        auto hash = whole ? file_hash(g::content_algo, fn) : edge_hash(g::content_algo, fn, exact_dups_t::EDGE);
+        if (whole) {
+            g::hash_avgs.w([&timer](auto &z) {
+                ++z.cnt;
+                z.dur += timer.dur<std::chrono::milliseconds>();
+            });
+        }
+        keep_hash(fn, stage, hash);
+        return hash;
+    } catch (const std::exception &ex) {
+        printf("%s\n", ex.what());
+        return {};
+    }
+}
+
+// run f on everything coming in until the queue is drained and closed, then let the next queue know
+template <typename I, typename O, typename F>
+void stage(bqueue_t<I> &in, bqueue_t<O> &out, const F &f) {
+    const auto closer = gvs::defer([&out] { out.done(); });
+    while (auto item = in.pop()) {
         try {
-            if (const auto fn = g::file_queue.get(.1s); !fn) {
-                if (!g::do_hash) break;
-            } else {
-                try {
-                    gvs::timer timer;
-                    // check modification time first
-                    auto mtime = gvs::json_time::tp2jv(from_ts(gvs::utl::statx(**fn).st_mtim));
-                    if (!g::database.r([&fn, &mtime](const auto &z) {
-                        const auto jvt = z[tag::files][**fn][tag::timestamp];
-                        return (jvt && jvt.isStr() && jvt == mtime);
-                    })) { // if problems - run hash
-                        auto hash = gvs::file_sha256h(**fn);
-                        g::database.w([&mtime, &recalculated, &fn, &hash](auto &z) {
-                            auto &jv = z[tag::files][**fn];
-                            auto &jvh = jv[tag::hash];
-                            if (!jvh || !jvh.isStr() || jvh.asStr() != hash) {
-                                jv.clear();
-                                jv[tag::hash] = std::move(hash);
-                                ++recalculated;
-                                ++g::db_recalcs;
-                            }
-
-                            if (auto &jvt = jv[tag::timestamp]; jvt != mtime) {
-                                jvt = std::move(mtime);
-                                ++g::db_recalcs;
-                            }
-                        });
-                        g::hash_avgs.w([&timer](auto &z) {
-                            ++z.cnt;
-                            z.dur += timer.dur<std::chrono::milliseconds>();
-                        });
-                    }
-                } catch (const std::exception &ex) {
-                    printf("%s\n", ex.what());
-                    g::database.w([&fn](auto &z) {
-                        z[tag::files].remove(**fn);
-                    });
-                }
-            }
+            f(std::move(*item));
         } catch (const std::exception &ex) {
             printf("%s\n", ex.what());
         }
     }
-    g::hash_avgs.w([&recalculated](auto &z) {
-        z.recalc += recalculated;
+}
+
+}
+
+void stat_stage() {
+    auto &out = g::disk_order ? g::order_queue : g::hash_queue;
+    stage(g::stat_queue, out, [&out](file_id_t id) {
+        const auto fn = g::files.path(id);
+        struct stat st;
+        try {
+            st = gvs::utl::statx(fn);
+        } catch (...) {
+            ++g::bad_inputs;
+            return;
+        }
+        out.push({id, st.st_mtim, st.st_size, g::disk_order ? disk_pos(fn, st) : disk_pos_t{}});
     });
 }
 
-void process_loop() {
-    using namespace std::chrono_literals;
-    while (true) { // make sure we only look at do_process if queue is empty
+void order_stage() {
+    const auto closer = gvs::defer([] { g::hash_queue.done(); });
+    std::vector<g::stated_t> files;
+    while (auto file = g::order_queue.pop()) files.push_back(std::move(*file));
+    gvs::timer timer;
+    const auto extents = std::count_if(files.begin(), files.end(), [](const auto &f) { return f.pos.offset.has_value(); });
+    files = order_by_disk(std::move(files), [](const g::stated_t &f) -> const disk_pos_t & { return f.pos; });
+    printf("Ordered %ld file(s) by disk position in %.2fs, %ld by extent, the rest by inode\n", files.size(), timer.measure<double>(), extents);
+    for (auto &file: files) g::hash_queue.push(std::move(file));
+}
+
+void hash_stage() {
+    stage(g::hash_queue, g::extract_queue, [](g::stated_t &&file) {
+        const auto fn = g::files.path(file.id);
+        bool stored{};
+        std::optional<g::stated_t> touched;
         try {
-            if (const auto fn = g::file_queue.get(.1s); !fn) {
-                if (!g::do_process) break;
-            } else {
-                // see if we can use a record from the db
-                if (!g::database.r([&fn](const auto &z) { return z[tag::files][**fn][tag::extract].isArr(); })) {
-                    recalc:
-                    ++g::db_recalcs;
-                    gvs::timer timer;
-                    if (const auto bmp = read_img(**fn); bmp) {
-                        g::bmp_avgs.w([&bmp, &timer](auto &z) {
-                            ++z.cnt;
-                            z.sz += bmp->bytes();
-                            z.dur += timer.dur<std::chrono::microseconds>();
-                        });
-
-                        bmp_averager_t bmp_info;
-                        timer.start();
-
-                        const auto [b_w, b_h] = bmp->dims();
-                        grid_t<g::GRID_W, g::GRID_H> gridder{b_w, b_h};
-                        for (u_int x{}; x < b_w; ++x) {
-                            for (u_int y{}; y < b_h; ++y) {
-                                bmp_info.val(gridder({x, y})) += bmp->px(x, y);
-                            }
-                        }
-
-                        gvs::json::val extract_jv;
-                        g::pointwithavg_t fileavgs;
-                        for (const auto &[p, val]: bmp_info.vals()) {
-                            const auto avgs = val(); // save the avgs as-is
-                            extract_jv.append(gvs::json::val{gvs::tval{tag::point, p.to_json()}, gvs::tval{tag::vals, avgs.to_json()}});
-                            // reduce the palette for lookups.
-                            const auto mavgs = px_t::mult<0, g::PX_N, g::PX_D>(avgs);
-                            g::grid2files.w([&p, &mavgs, &fn](auto &z) { z[p][mavgs].emplace(*fn); });
-                            fileavgs.emplace(p, mavgs);
-                        }
-                        g::database.w([&fn, &extract_jv](auto &z) {
-                            z[tag::files][**fn][tag::extract] = std::move(extract_jv);
-                        });
-                        g::file2grids.w([&fn, &fileavgs](auto &z) {
-                            z.emplace_back(std::make_unique<g::fileandgrid_t::element_type>(*fn, std::move(fileavgs)));
-                        });
-
-                        g::proc_avgs.w([&bmp, &timer](auto &z) {
-                            ++z.recalc;
-                            ++z.cnt;
-                            z.sz += bmp->bytes();
-                            z.dur += timer.dur<std::chrono::milliseconds>();
-                        });
-                    } else {
-                        g::bad_files.w([&fn](auto &z) { z.emplace_back(*fn); });
-                        g::database.w([&fn](auto &z) { z[tag::files].remove(**fn); });
-                    }
-                } else {
-                    try {
-                        gvs::timer timer;
-                        g::database.r([&fn](const auto &z) {
-                            g::pointwithavg_t fileavgs;
-                            for (const auto &jv: z[tag::files][**fn][tag::extract].asArr()) {
-                                point_t p{jv[tag::point]};
-                                auto avgs = px_t::mult<0, g::PX_N, g::PX_D>(jv[tag::vals]);
-                                g::grid2files.w([&p, &avgs, &fn](auto &z) { z[p][avgs].emplace(*fn); });
-                                fileavgs.emplace(p, avgs);
-                            }
-                            g::file2grids.w([&fn, &fileavgs](auto &z) {
-                                z.emplace_back(std::make_unique<g::fileandgrid_t::element_type>(*fn, std::move(fileavgs)));
-                            });
-                        });
-                        g::proc_avgs.w([&timer](auto &z) {
-                            ++z.cnt;
-                            z.dur += timer.dur<std::chrono::milliseconds>();
-                        });
-                    } catch (...) {
-                        goto recalc;
-                    }
+            // check modification time first
+            const auto mtime = gvs::json_time::tp2jv(from_ts(file.mtime));
+            exact_dups_t::content_t content{file.size};
+            const auto [same, stamped, hashed] = g::database.head(fn, [&mtime, &content](const auto &z) {
+                const auto jvt = z[tag::timestamp];
+                const auto same = jvt && jvt.isStr() && jvt == mtime;
+                // hashes made with another algorithm get redone if they're needed
+                const auto current = [](const auto &jvh) { return jvh.isStr() && stored_algo(jvh.asStr()) == g::content_algo; };
+                if (same && current(z[tag::partial])) content.partial = z[tag::partial].asStr();
+                if (same && current(z[tag::hash])) content.full = z[tag::hash].asStr();
+                return std::make_tuple(same, z[tag::mtime].isInt(), z[tag::hash].isStr());
+            });
+            if (same && !stamped) { // records from before the binary store only have the timestamp
+                g::database.w(fn, [&file](auto &jv) { stamp(jv, file, [](auto &) {}); });
+                ++g::db_recalcs;
+            }
+            if (!same) { // if problems - run hash
+                // a touched file's full hash is compared with the record's before its grid is trusted, from the
+                // bytes the decoder gets. a new file, or one with nothing to compare with, starts over and gets
+                // hashed only if exact duplicate detection needs it, or fused, from the decoder's bytes as well
+                if (!hashed) {
+                    g::database.w(fn, [&file](auto &jv) {
+                        stamp(jv, file, [](auto &jv) { jv.clear(); });
+                    });
                 }
+                if (hashed || g::fused) touched = file;
             }
-        } catch (const std::exception &ex) {
+
+            // byte identical files get extracted once, the first one to come by stands for the rest
+            const auto first = g::exact_dups.add(file.id, content, stage_hash);
+            if (same && file.id < g::unchanged.size()) { // matched last run, its grid and clusters are in last_match
+                g::unchanged[file.id] = true;
+                return;
+            }
+            if (first) { // a copy never gets to the decoders, it's checked here. rare, it was read for its hash already
+                if (touched && hashed) same_content(*touched, fn, nullptr);
+                return;
+            }
+            stored = !g::verify_dc && !g::database.cells(fn, {g::grid_w, g::grid_h}).empty();
+        } catch (const std::exception &ex) { // unreadable, it goes with the bad files
             printf("%s\n", ex.what());
+            ++g::bad_inputs;
+            g::bad_files.w([&file](auto &z) { z.emplace_back(file.id); });
+            g::database.remove(fn);
+            return;
         }
-    }
+        g::extract_queue.push({file.id, stored, std::move(touched)});
+    });
 }
 
-void match_loop() {
-    using namespace std::chrono_literals;
-    const auto &grid2files = g::grid2files.r([](const auto &z) -> decltype(auto) {return z;}); // direct access - its read-only now
-
-    while (true) {
-        if (const auto fng = g::fileandgrid_queue.get(.1s); !fng) {
-            if (!g::do_match) break;
-        } else {
-            avg_t<int> avg_lum;
-            const auto &[fn, grid] = **fng;
-            std::unordered_map<g::string_ptr, int> ftree; // to count grid natches per file that matches this particular grid piece
-            for (const auto &[point, avgs]: grid) { // iterate on grid per file
-                avg_lum += avgs.lum();
-//                printf("iter: [%d,%d]: %d,%d,%d\n", point.x, point.y, avgs.r, avgs.g, avgs.b);
-                if (const auto point_it = grid2files.find(point); point_it != grid2files.end()) {
-                    const auto &avgs_map = point_it->second;
-                    if (const auto avg_it = avgs_map.find(avgs); avg_it != avgs_map.cend()) {
-                        for (const auto &mfn: avg_it->second) {
-                            if (fn == mfn) continue;
-                            ++ftree[mfn];
-                        }
-                    }
-                }
+void read_stage() {
+    stage(g::extract_queue, g::read_queue, [](g::to_extract_t &&file) {
+        g::read_t ret{file.id, file.stored, std::move(file.touched)};
+        if (!file.stored || ret.touched) {
+            try {
+                ret.buf.emplace(read_input(g::files.path(file.id)));
+            } catch (...) { // the decoder reads it again and reports it
             }
-            if (avg_lum() > 2) g::duplicates.w([&fn](auto &list){list.front().emplace(fn);});
+        }
+        g::read_queue.push(std::move(ret));
+    });
+}
 
-            std::set<g::string_ptr> matching_files;
-            for (const auto &[mfn, cnt]: ftree) {
-                if (cnt >= g::GRID_W * g::GRID_H * g::PASSABLE_RATE::num / g::PASSABLE_RATE::den) {
-                    matching_files.emplace(mfn);
+void uring_read_stage(uring_reader_t &ring) {
+    std::unordered_map<file_id_t, g::to_extract_t> in_ring; // what the files in the ring came with
+    const auto ready = [&in_ring](uint64_t id) {
+        auto node = in_ring.extract(static_cast<file_id_t>(id));
+        return node ? g::read_t{node.mapped().id, node.mapped().stored, std::move(node.mapped().touched)} : g::read_t{static_cast<file_id_t>(id)};
+    };
+    const auto done = [&ready](uint64_t id, std::optional<gvs::dynbuf<uint8_t>> &&bytes, std::chrono::microseconds took) {
+        auto ret = ready(id);
+        if (bytes) {
+            g::read_avgs.w([&bytes, took](auto &z) {
+                z.sz += bytes->size();
+                ++z.cnt;
+                z.dur += took;
+            });
+            ret.buf.emplace(std::move(*bytes));
+        }
+        g::read_queue.push(std::move(ret));
+    };
+    std::optional<file_id_t> popped; // off the queue and not in the ring yet
+    try {
+        for (bool more{true}; more || ring.in_flight() > 0;) {
+            // top the ring up with whatever is there, waiting for files only when nothing is in flight
+            while (more && !ring.full()) {
+                auto file = ring.in_flight() > 0 ? g::extract_queue.try_pop() : g::extract_queue.pop();
+                if (!file) {
+                    more = !g::extract_queue.drained();
+                    break;
+                }
+                popped = file->id;
+                if (file->stored && !file->touched) {
+                    g::read_queue.push({file->id, true});
+                } else {
+                    const auto id = file->id;
+                    in_ring.emplace(id, std::move(*file));
+                    ring.submit(id, g::files.path(id));
                 }
+                popped.reset();
             }
-            if (!matching_files.empty()) {
-                matching_files.emplace(fn);
-                g::duplicates.w([&matching_files] (auto &list) {
-                    list.emplace_back(std::move(matching_files));
-                });
+            ring.reap(true, done);
+        }
+    } catch (const std::exception &ex) {
+        // the files in the ring go to the decoders without their bytes, they read them themselves
+        auto lost = ring.abandon();
+        if (popped && std::find(lost.begin(), lost.end(), *popped) == lost.end()) lost.push_back(*popped);
+        printf("%s, reading %zu file(s) in flight and the rest without io_uring\n", ex.what(), lost.size());
+        for (const auto id: lost) g::read_queue.push(ready(id));
+    }
+    read_stage(); // whatever is left, and closes the read queue
+}
+
+void extract_stage() {
+    stage(g::read_queue, g::index_queue, [](g::read_t &&file) {
+        const auto fn = g::files.path(file.id);
+        const auto *buf = file.buf ? &*file.buf : nullptr;
+        // a touched file's record is trusted if the bytes are still what it was hashed from, a fused new one gets
+        // its hash from them
+        if (file.touched) {
+            try {
+                if (!same_content(*file.touched, fn, buf).first) file.stored = false;
+            } catch (const std::exception &ex) { // unreadable, it goes with the bad files
+                printf("%s\n", ex.what());
+                ++g::bad_inputs;
+                g::bad_files.w([&file](auto &z) { z.emplace_back(file.id); });
+                g::database.remove(fn);
+                return;
+            }
+        }
+        // see if we can use a record from the db
+        if (file.stored) {
+            try {
+                g::index_queue.push(stored_file(file.id, fn));
+                return;
+            } catch (...) {
             }
         }
+        if (auto indexed = recalc_file(file.id, fn, buf); indexed) g::index_queue.push(std::move(*indexed));
+    });
+}
+
+void index_stage() {
+    const auto closer = gvs::defer([] { g::compact_queue.done(); });
+    // cells go into this thread's part of the index, the index gets built from the parts once every thread is done
+    inverted_index_t::builder_t part;
+    while (auto indexed = g::index_queue.pop()) {
+        auto &[id, grid, ph] = *indexed;
+        for (const auto &[p, avgs]: grid) part.add(cell_key(p, g::reduced(avgs)), id);
+        if (ph && g::phash_dist >= 0) g::phashes.w([id, &ph](auto &z) { z.emplace_back(id, *ph); });
+        g::file2grids.w([id, &grid](auto &z) {
+            z.emplace_back(std::make_unique<g::fileandgrid_t::element_type>(id, std::move(grid)));
+        });
+        // folded in by the compact stage, one at a time, the index goes on meanwhile
+        if (g::database.compact_due(g::database.journal_size(), g::JOURNAL_COMPACT) && !g::compacting.exchange(true)) g::compact_queue.push(true);
     }
+    part.finish();
+    g::index_parts.w([&part](auto &z) { z.push_back(std::move(part)); });
 }
 
+void compact_stage() {
+    while (g::compact_queue.pop()) {
+        gvs::timer timer;
+        try {
+            g::database.compact(g::DB_STORE);
+            printf("Compacted the database in %.2fs\n", timer.measure<double>());
+        } catch (const std::exception &ex) { // not again this run, the journal keeps everything
+            printf("%s\n", ex.what());
+            continue;
+        }
+        g::compacting = false;
+    }
 }
 
-void worker() {
-    using namespace std::chrono_literals;
+void match_stage() {
+    const auto threshold = static_cast<u_int>(g::grid_w * g::grid_h * g::PASSABLE_RATE::num / g::PASSABLE_RATE::den);
+    matcher_t matcher{g::grid_index, g::files.size(), threshold, g::symmetric};
+    if (!g::unchanged.empty()) matcher.add_stored(g::last_match.index, g::unchanged);
+    std::vector<uint64_t> keys;
+    std::vector<file_id_t> matches;
 
-    g::worker_state.w([](auto &z) { ++z.hashing; });
-    hash_loop();
-    g::worker_state.w([](auto &z) {
-        --z.hashing;
-        ++z.processing;
-    });
-    process_loop();
-    g::worker_state.w([](auto &z) {
-        --z.processing;
-        ++z.matching;
-    });
-    match_loop();
-    g::worker_state.w([](auto &z) { --z.matching; });
+    while (const auto fng = g::fileandgrid_queue.pop()) {
+        avg_t<int> avg_lum;
+        const auto &[id, grid] = **fng;
+        keys.clear();
+        for (const auto &[point, avgs]: grid) { // iterate on grid per file
+            const auto px = g::reduced(avgs);
+            avg_lum += px.lum();
+            if (g::tolerance) probe_keys<g::PX_N, g::PX_D>(point, avgs, g::tolerance, keys);
+            else keys.push_back(cell_key(point, px));
+        }
+        if (avg_lum() > 2) g::duplicates.w([id](auto &list){list.front().emplace(id);});
+
+        matcher.match(id, keys, matches);
+        if (g::tolerance) { // probing counts a whole neighboring bucket, the full colors tell
+            std::erase_if(matches, [id, threshold](file_id_t mid) {
+                return g::cell_vals.agreeing<g::PX_N, g::PX_D>(id, mid, g::tolerance) < threshold;
+            });
+        }
+        if (g::clustering == g::clustering_t::union_find) {
+            for (const auto mid: matches) g::clusters.unite(id, mid);
+        } else if (!matches.empty()) {
+            std::set<file_id_t> matching_files{matches.begin(), matches.end()};
+            matching_files.emplace(id);
+            g::duplicates.w([&matching_files] (auto &list) {
+                list.emplace_back(std::move(matching_files));
+            });
+        }
+    }
+    g::match_stats.w([&matcher](auto &z) { z += matcher.stats(); });
 }
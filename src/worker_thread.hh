@@ -1,4 +1,15 @@
 
 #pragma once
 
-void worker();
+class uring_reader_t;
+
+// pipeline stages, each runs until its input queue is closed and drained, the last one out closes the next queue
+void stat_stage();
+void order_stage(); // single thread, holds everything back until the scan is done
+void hash_stage();
+void read_stage(); // read_depth of these, blocking
+void uring_read_stage(uring_reader_t &ring); // single thread, read_depth reads in flight
+void extract_stage();
+void index_stage(); // single thread
+void compact_stage(); // single thread, folds the journal into the store when the index threads ask
+void match_stage(); // once the index is complete
@@ -0,0 +1,89 @@
+
+#include "xxh64.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t P1{0x9e3779b185ebca87ull};
+constexpr uint64_t P2{0xc2b2ae3d27d4eb4full};
+constexpr uint64_t P3{0x165667b19e3779f9ull};
+constexpr uint64_t P4{0x85ebca77c2b2ae63ull};
+constexpr uint64_t P5{0x27d4eb2f165667c5ull};
+
+// little endian reads, the hash is defined on those
+uint64_t read64(const uint8_t *p) noexcept {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    if constexpr (std::endian::native == std::endian::big) v = __builtin_bswap64(v);
+    return v;
+}
+
+uint32_t read32(const uint8_t *p) noexcept {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    if constexpr (std::endian::native == std::endian::big) v = __builtin_bswap32(v);
+    return v;
+}
+
+uint64_t round(uint64_t acc, uint64_t input) noexcept {
+    return std::rotl(acc + input * P2, 31) * P1;
+}
+
+uint64_t merge(uint64_t acc, uint64_t val) noexcept {
+    return (acc ^ round(0, val)) * P1 + P4;
+}
+
+}
+
+xxh64_t::xxh64_t(uint64_t seed) noexcept: m_acc{seed + P1 + P2, seed + P2, seed, seed - P1}, m_seed{seed} {}
+
+void xxh64_t::update(const void *data, size_t size) noexcept {
+    auto p = static_cast<const uint8_t *>(data);
+    m_total += size;
+    if (m_buffered) { // top up what's left from last time to a whole stripe first
+        const auto n = std::min(size, sizeof(m_buf) - m_buffered);
+        std::memcpy(m_buf + m_buffered, p, n);
+        m_buffered += n;
+        p += n;
+        size -= n;
+        if (m_buffered < sizeof(m_buf)) return;
+        for (int i{}; i < 4; ++i) m_acc[i] = round(m_acc[i], read64(m_buf + i * 8));
+        m_buffered = 0;
+    }
+    for (; size >= 32; p += 32, size -= 32) {
+        for (int i{}; i < 4; ++i) m_acc[i] = round(m_acc[i], read64(p + i * 8));
+    }
+    std::memcpy(m_buf, p, size);
+    m_buffered = size;
+}
+
+uint64_t xxh64_t::digest() const noexcept {
+    uint64_t h;
+    if (m_total >= 32) {
+        h = std::rotl(m_acc[0], 1) + std::rotl(m_acc[1], 7) + std::rotl(m_acc[2], 12) + std::rotl(m_acc[3], 18);
+        for (int i{}; i < 4; ++i) h = merge(h, m_acc[i]);
+    } else {
+        h = m_seed + P5;
+    }
+    h += m_total;
+
+    const uint8_t *p = m_buf;
+    auto left = m_buffered;
+    for (; left >= 8; p += 8, left -= 8) h = std::rotl(h ^ round(0, read64(p)), 27) * P1 + P4;
+    if (left >= 4) {
+        h = std::rotl(h ^ (read32(p) * P1), 23) * P2 + P3;
+        p += 4;
+        left -= 4;
+    }
+    for (; left; ++p, --left) h = std::rotl(h ^ (*p * P5), 11) * P1;
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
@@ -0,0 +1,29 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64 bit xxHash, fed in pieces of any size. not cryptographic, several times faster than sha256, plenty for
+// telling whether a file changed or two files are the same
+class xxh64_t {
+public:
+    explicit xxh64_t(uint64_t seed = 0) noexcept;
+
+    void update(const void *data, size_t size) noexcept;
+
+    [[nodiscard]] uint64_t digest() const noexcept;
+
+    static uint64_t hash(const void *data, size_t size, uint64_t seed = 0) noexcept {
+        xxh64_t h{seed};
+        h.update(data, size);
+        return h.digest();
+    }
+
+private:
+    uint64_t m_acc[4];
+    uint64_t m_seed;
+    uint64_t m_total{};
+    uint8_t m_buf[32];
+    size_t m_buffered{};
+};
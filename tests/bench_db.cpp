@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+// database contention: the workers' per file read-check-then-write, one global json mutex against the shards
+
+#include "database.hh"
+#include "tags.hh"
+
+#include <gvs_json.hh>
+#include <gvs_mutexed.hh>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr const int files{200'000};
+
+template<typename F>
+double measure(u_int threads, const F &f) {
+    std::list<std::thread> workers;
+    const auto start = std::chrono::steady_clock::now();
+    for (u_int t{}; t < threads; ++t) {
+        workers.emplace_back([&f, t, threads] {
+            for (int i = t; i < files; i += threads) f(i);
+        });
+    }
+    for (auto &w: workers) w.join();
+    return files / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> names;
+    for (int i{}; i < files; ++i) names.push_back("/some/folder/" + std::to_string(i / 1000) + "/IMG_" + std::to_string(i) + ".jpg");
+
+    gvs::mutexed<gvs::json::val> one;
+    database_t sharded;
+    const auto hw = std::max(1u, std::thread::hardware_concurrency());
+    printf("%8s %14s %14s\n", "threads", "global files/s", "sharded files/s");
+    for (u_int threads{1}; threads <= hw; threads *= 2) {
+        // what hash_stage does for a file that changed: check the timestamp, then write hash and timestamp
+        const auto global = measure(threads, [&one, &names](int i) {
+            const auto &fn = names[i];
+            if (one.r([&fn](const auto &z) { return z[tag::files][fn][tag::timestamp].isStr(); })) return;
+            one.w([&fn, i](auto &z) {
+                auto &jv = z[tag::files][fn];
+                jv[tag::hash] = std::to_string(i);
+                jv[tag::timestamp] = std::to_string(i);
+            });
+        });
+        const auto shards = measure(threads, [&sharded, &names](int i) {
+            const auto &fn = names[i];
+            if (sharded.r(fn, [](const auto &z) { return z[tag::timestamp].isStr(); })) return;
+            sharded.w(fn, [i](auto &jv) {
+                jv[tag::hash] = std::to_string(i);
+                jv[tag::timestamp] = std::to_string(i);
+            });
+        });
+        printf("%8u %14.0f %14.0f\n", threads, global, shards);
+        one.w([](auto &z) { z.clear(); });
+        sharded.release();
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+// grid averaging throughput: the old per pixel bmp_averager_t loop against the row kernels
+
+#include "bmp.hh"
+#include "bmp_averager.hh"
+#include "grid.hh"
+#include "grid_accumulator.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace {
+
+template<typename F>
+void measure(const char *name, size_t pixels, const F &f) {
+    constexpr int rounds{5};
+    const auto start = std::chrono::steady_clock::now();
+    for (int i{}; i < rounds; ++i) f();
+    const auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-10s %8.1f Mpx/s\n", name, pixels * rounds / secs / 1e6);
+}
+
+}
+
+int main(int argc, char **argv) {
+    const u_int w{6000}, h{4000};
+    for (const u_int pxs: {3U, 1U}) {
+        printf("%ux%u, %u byte(s) per pixel\n", w, h, pxs);
+        bmp_t bmp{w, h, pxs};
+        std::mt19937 rnd{1};
+        for (u_int y{}; y < h; ++y) {
+            auto *row = bmp.row(y);
+            for (u_int i{}; i < w * pxs; ++i) row[i] = rnd();
+        }
+
+        measure("per-pixel", size_t{w} * h, [&bmp, w, h] {
+            bmp_averager_t info;
+            grid_t gridder{g::grid_w, g::grid_h, w, h};
+            for (u_int x{}; x < w; ++x) {
+                for (u_int y{}; y < h; ++y) info.val(gridder({x, y})) += bmp.px(x, y);
+            }
+        });
+
+        for (const auto simd: {simd_t::scalar, simd_t::sse2, simd_t::avx2}) {
+            if (static_cast<int>(simd) > static_cast<int>(best_simd())) continue;
+            measure(simd_name(simd), size_t{w} * h, [&bmp, simd, w, h, pxs] {
+                grid_accumulator_t acc{{point_t{g::grid_w, g::grid_h}}, simd};
+                acc.begin(w, h, pxs);
+                acc.rows(0, bmp.row(0), h, size_t{w} * pxs);
+            });
+        }
+
+        measure("stored", size_t{w} * h, [&bmp, w, h, pxs] { // every extract_grids grid in one pass
+            grid_accumulator_t acc;
+            acc.begin(w, h, pxs);
+            acc.rows(0, bmp.row(0), h, size_t{w} * pxs);
+        });
+    }
+    return 0;
+}
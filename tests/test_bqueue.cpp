@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "bqueue.hh"
+
+#include <atomic>
+#include <list>
+#include <thread>
+
+TEST_CASE( "bqueue", "drained before it reports closed" ) {
+    bqueue_t<int> q{4};
+    q.producers(1);
+    for (int i{}; i < 4; ++i) REQUIRE(q.push(i));
+    q.done();
+    REQUIRE(!q.push(4));
+    for (int i{}; i < 4; ++i) REQUIRE(q.pop() == i);
+    REQUIRE(!q.pop());
+}
+
+TEST_CASE( "bqueue stages", "every item makes it through two stages, the last producer closes" ) {
+    constexpr int producers{3}, middle{4}, per_producer{5000};
+    bqueue_t<int> first{8}, second{8};
+    first.producers(producers);
+    second.producers(middle);
+
+    std::list<std::thread> threads;
+    for (int p{}; p < producers; ++p) threads.emplace_back([&first, p] {
+        for (int i{}; i < per_producer; ++i) first.push(p * per_producer + i);
+        first.done();
+    });
+    for (int m{}; m < middle; ++m) threads.emplace_back([&first, &second] {
+        while (auto v = first.pop()) second.push(*v + 1);
+        second.done();
+    });
+
+    long sum{}, cnt{};
+    while (auto v = second.pop()) {
+        sum += *v;
+        ++cnt;
+    }
+    for (auto &t: threads) t.join();
+
+    constexpr long n{producers * per_producer};
+    REQUIRE(cnt == n);
+    REQUIRE(sum == n * (n + 1) / 2);
+}
+
+TEST_CASE( "bqueue try_pop", "empty for now and drained for good are told apart" ) {
+    bqueue_t<int> q{4};
+    q.producers(1);
+    REQUIRE(!q.try_pop());
+    REQUIRE(!q.drained());
+    REQUIRE(q.push(1));
+    q.done();
+    REQUIRE(!q.drained());
+    REQUIRE(q.try_pop() == 1);
+    REQUIRE(!q.try_pop());
+    REQUIRE(q.drained());
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "database.hh"
+#include "extract.hh"
+#include "px.hh"
+#include "tags.hh"
+
+#include <gvs_json_time.hh>
+
+#include <chrono>
+#include <cstdlib>
+
+#include <unistd.h>
+
+TEST_CASE( "database", "the document comes back the way it went in" ) {
+    gvs::json::val doc;
+    for (int i{}; i < 1000; ++i) doc[tag::files]["/f" + std::to_string(i)][tag::hash] = std::to_string(i);
+    doc[tag::grid][tag::x] = 3;
+
+    database_t db;
+    db.load(std::move(doc));
+    REQUIRE(db.size() == 1000);
+    REQUIRE(db.meta()[tag::grid][tag::x].asInt() == 3);
+    REQUIRE(db.r("/f7", [](const auto &z) { return z[tag::hash].asStr(); }) == "7");
+    REQUIRE(!db.r("/nope", [](const auto &z) { return z[tag::hash].isStr(); }));
+
+    db.w("/new", [](auto &z) { z[tag::hash] = std::string{"new"}; });
+    db.remove("/f0");
+    REQUIRE(db.size() == 1000);
+
+    auto out = db.release();
+    REQUIRE(db.size() == 0);
+    REQUIRE(out[tag::files].size() == 1000);
+    REQUIRE(out[tag::files]["/new"][tag::hash].asStr() == "new");
+    REQUIRE(out[tag::files]["/f999"][tag::hash].asStr() == "999");
+    REQUIRE(!out[tag::files]["/f0"]);
+    REQUIRE(out[tag::grid][tag::x].asInt() == 3);
+}
+
+TEST_CASE( "database store", "records make it through the binary store and back, edits on top of it saved" ) {
+    const point_t grid{3, 3};
+    gvs::json::val doc;
+    for (int i{}; i < 500; ++i) {
+        auto &jv = doc[tag::files]["/f" + std::to_string(i)];
+        // full hashes of either algorithm, partial ones, and files only their size told apart
+        if (i % 6 == 3) jv[tag::hash] = "xxh64:" + std::string(16, "0123456789abcdef"[i % 16]);
+        else if (i % 3 == 0) jv[tag::hash] = std::string(64, "0123456789abcdef"[i % 16]);
+        else if (i % 3 == 1) jv[tag::partial] = std::string(64, "0123456789abcdef"[i % 16]);
+        // and records from before the binary store, stamped with the timestamp only
+        if (i % 5 == 2) jv[tag::timestamp] = gvs::json_time::tp2jv(std::chrono::system_clock::time_point{std::chrono::seconds{i}});
+        else jv[tag::mtime] = 1'000'000'000L * i;
+        jv[tag::size] = static_cast<long>(i);
+        auto &cells = jv[tag::extracts][grid_key(grid)];
+        for (u_int y{}; y < grid.y; ++y) {
+            for (u_int x{}; x < grid.x; ++x) {
+                cells.append(gvs::json::val{gvs::tval{tag::point, point_t{x, y}.to_json()}, gvs::tval{tag::vals, px_t{i % 256, int(x), int(y)}.to_json()}});
+            }
+        }
+    }
+    char fn[] = "/tmp/imgproc_store_XXXXXX";
+    close(mkstemp(fn));
+
+    database_t db;
+    db.load(gvs::json::val{doc});
+    db.save(fn, {grid});
+
+    database_t stored;
+    stored.open(fn);
+    REQUIRE(stored.size() == 500);
+    REQUIRE(stored.content_algo() == hash_algo_t::sha256);
+    for (int i{}; i < 500; i += 7) {
+        const auto name = "/f" + std::to_string(i);
+        stored.r(name, [&doc, &name, &grid, i](const auto &z) {
+            REQUIRE(z[tag::hash].isStr() == (i % 3 == 0));
+            REQUIRE(z[tag::partial].isStr() == (i % 3 == 1));
+            if (i % 3 == 0) REQUIRE(z[tag::hash] == doc[tag::files][name][tag::hash]);
+            if (i % 3 == 1) REQUIRE(z[tag::partial] == doc[tag::files][name][tag::partial]);
+            REQUIRE(z[tag::size].asInt() == doc[tag::files][name][tag::size].asInt());
+            REQUIRE(z[tag::mtime].asInt() == 1'000'000'000L * i);
+            if (i % 5 == 2) REQUIRE(z[tag::timestamp] == doc[tag::files][name][tag::timestamp]);
+            REQUIRE(z[tag::extracts][grid_key(grid)] == doc[tag::files][name][tag::extracts][grid_key(grid)]);
+        });
+        // the cells straight from the record, the last one is (2, 2)
+        const auto cells = stored.cells(name, grid);
+        REQUIRE(cells.size() == 27);
+        REQUIRE(px_t{cells.data() + 24, 3} == px_t{i % 256, 2, 2});
+        REQUIRE(stored.cells(name, {8, 8}).empty());
+    }
+
+    stored.remove("/f1");
+    stored.w("/f2", [](auto &z) { z[tag::size] = 2000L; });
+    stored.content_algo(hash_algo_t::xxh64);
+    stored.save(fn, {grid});
+
+    database_t again;
+    again.open(fn);
+    unlink(fn);
+    REQUIRE(again.size() == 499);
+    REQUIRE(again.content_algo() == hash_algo_t::xxh64);
+    REQUIRE(!again.r("/f1", [](const auto &z) { return bool(z); }));
+    REQUIRE(again.r("/f2", [](const auto &z) { return z[tag::size].asInt(); }) == 2000);
+    REQUIRE(again.cells("/f1", grid).empty());
+    REQUIRE(again.release()[tag::files].size() == 499);
+}
+
+TEST_CASE( "database legacy extract", "a single grid extract from before there were several is stored as the document's grid" ) {
+    const point_t grid{2, 2};
+    gvs::json::val doc;
+    doc[tag::grid] = grid.to_json();
+    auto &cells = doc[tag::files]["/old"][tag::extract];
+    for (u_int y{}; y < grid.y; ++y) {
+        for (u_int x{}; x < grid.x; ++x) cells.append(gvs::json::val{gvs::tval{tag::point, point_t{x, y}.to_json()}, gvs::tval{tag::vals, px_t{5, int(x), int(y)}.to_json()}});
+    }
+    char fn[] = "/tmp/imgproc_store_XXXXXX";
+    close(mkstemp(fn));
+
+    database_t db;
+    db.load(gvs::json::val{doc});
+    db.save(fn, {{3, 3}, grid});
+    database_t stored;
+    stored.open(fn);
+    unlink(fn);
+    REQUIRE(stored.r("/old", [&grid](const auto &z) { return z[tag::extracts][grid_key(grid)]; }) == cells);
+    REQUIRE(!stored.r("/old", [](const auto &z) { return z[tag::extracts][grid_key({3, 3})].isArr(); }));
+}
+
+TEST_CASE( "database journal", "changes come back from the journal, a torn last entry is left out, compacting folds it in" ) {
+    const point_t grid{2, 2};
+    char store_fn[] = "/tmp/imgproc_store_XXXXXX";
+    close(mkstemp(store_fn));
+    const std::string journal_fn{std::string{store_fn} + ".journal"};
+
+    database_t db;
+    for (int i{}; i < 100; ++i) db.w("/f" + std::to_string(i), [i](auto &z) { z[tag::size] = static_cast<long>(i); });
+    db.save(store_fn, {grid});
+    db.open(store_fn);
+
+    db.start_journal(journal_fn, {grid});
+    db.w("/f3", [](auto &z) { z[tag::size] = 3000L; });
+    db.w("/new", [&grid](auto &z) {
+        z[tag::size] = 1L;
+        for (u_int y{}; y < grid.y; ++y) {
+            for (u_int x{}; x < grid.x; ++x) {
+                z[tag::extracts][grid_key(grid)].append(gvs::json::val{gvs::tval{tag::point, point_t{x, y}.to_json()}, gvs::tval{tag::vals, px_t{9, int(x), int(y)}.to_json()}});
+            }
+        }
+    });
+    // a grid with cells missing isn't kept
+    db.w("/partial", [&grid](auto &z) {
+        z[tag::size] = 1L;
+        z[tag::extracts][grid_key(grid)].append(gvs::json::val{gvs::tval{tag::point, point_t{1, 1}.to_json()}, gvs::tval{tag::vals, px_t{9, 8, 7}.to_json()}});
+    });
+    db.remove("/f4");
+    const auto journaled = db.journal_size();
+    db.w("/torn", [](auto &z) { z[tag::size] = 5L; });
+    REQUIRE(db.journal_size() > journaled);
+    REQUIRE(truncate(journal_fn.c_str(), static_cast<off_t>(db.journal_size() - 1)) == 0);
+
+    database_t replayed;
+    replayed.open(store_fn);
+    REQUIRE(replayed.replay(journal_fn) == 4);
+    REQUIRE(replayed.size() == 101);
+    REQUIRE(replayed.r("/f3", [](const auto &z) { return z[tag::size].asInt(); }) == 3000);
+    REQUIRE(!replayed.r("/f4", [](const auto &z) { return bool(z); }));
+    REQUIRE(!replayed.r("/torn", [](const auto &z) { return bool(z); }));
+    REQUIRE(replayed.r("/new", [&grid](const auto &z) { return px_t{z[tag::extracts][grid_key(grid)].asArr()[3][tag::vals]}; }) == px_t{9, 1, 1});
+    REQUIRE(replayed.r("/partial", [](const auto &z) { return z[tag::size].asInt() == 1 && !z[tag::extracts].isObj(); }));
+
+    db.compact(store_fn);
+    REQUIRE(access((journal_fn + ".old").c_str(), F_OK) != 0);
+    database_t compacted;
+    compacted.open(store_fn);
+    REQUIRE(compacted.replay(journal_fn) == 0);
+    REQUIRE(compacted.size() == 102);
+    REQUIRE(compacted.r("/torn", [](const auto &z) { return z[tag::size].asInt(); }) == 5);
+    REQUIRE(compacted.r("/f3", [](const auto &z) { return z[tag::size].asInt(); }) == 3000);
+
+    unlink(journal_fn.c_str());
+    unlink(store_fn);
+}
+
+TEST_CASE( "database journal carried on", "the next run appends past the last whole entry, a journal of other grids starts over with what was replayed" ) {
+    const point_t grid{2, 2};
+    char store_fn[] = "/tmp/imgproc_store_XXXXXX";
+    close(mkstemp(store_fn));
+    const std::string journal_fn{std::string{store_fn} + ".journal"};
+    const auto size = [](const auto &z) { return z[tag::size].asInt(); };
+
+    {
+        database_t db;
+        db.w("/a", [](auto &z) { z[tag::size] = 1L; });
+        db.save(store_fn, {grid});
+        db.open(store_fn);
+        db.start_journal(journal_fn, {grid});
+        db.w("/b", [](auto &z) { z[tag::size] = 2L; });
+        db.w("/torn", [](auto &z) { z[tag::size] = 3L; });
+        REQUIRE(truncate(journal_fn.c_str(), static_cast<off_t>(db.journal_size() - 1)) == 0);
+    }
+
+    database_t next;
+    next.open(store_fn);
+    REQUIRE(next.replay(journal_fn) == 1);
+    next.start_journal(journal_fn, {grid});
+    next.w("/c", [](auto &z) { z[tag::size] = 4L; });
+    REQUIRE(!next.compact_due(1, 0));
+    REQUIRE(next.compact_due(1ul << 30, 0));
+
+    database_t third;
+    third.open(store_fn);
+    REQUIRE(third.replay(journal_fn) == 2);
+    REQUIRE(third.r("/b", size) == 2);
+    REQUIRE(third.r("/c", size) == 4);
+    REQUIRE(!third.r("/torn", [](const auto &z) { return bool(z); }));
+
+    third.start_journal(journal_fn, {grid, {3, 3}});
+    database_t fourth;
+    fourth.open(store_fn);
+    REQUIRE(fourth.replay(journal_fn) == 2);
+    REQUIRE(fourth.r("/c", size) == 4);
+    REQUIRE(fourth.size() == 3);
+
+    unlink(journal_fn.c_str());
+    unlink(store_fn);
+}
+
+TEST_CASE( "database update", "only records that are there and that f changed get kept and journaled" ) {
+    const point_t grid{2, 2};
+    char store_fn[] = "/tmp/imgproc_store_XXXXXX";
+    close(mkstemp(store_fn));
+    const std::string journal_fn{std::string{store_fn} + ".journal"};
+    const auto partial = [](const auto &z) { return z[tag::partial].isStr() ? z[tag::partial].asStr() : std::string{}; };
+
+    database_t db;
+    db.w("/a", [](auto &z) { z[tag::size] = 1L; });
+    db.w("/b", [](auto &z) { z[tag::size] = 2L; });
+    db.save(store_fn, {grid});
+    db.open(store_fn);
+    db.start_journal(journal_fn, {grid});
+    const auto started = db.journal_size();
+
+    REQUIRE(!db.update("/nope", [](auto &) { return true; }));
+    REQUIRE(!db.update("/a", [](auto &z) {
+        z[tag::partial] = std::string{"left out"};
+        return false;
+    }));
+    REQUIRE(db.journal_size() == started);
+    REQUIRE(db.update("/b", [](auto &z) {
+        z[tag::partial] = std::string(64, 'b');
+        return true;
+    }));
+    REQUIRE(db.journal_size() > started);
+    REQUIRE(db.size() == 2);
+    REQUIRE(db.r("/a", partial).empty());
+    REQUIRE(db.r("/b", partial) == std::string(64, 'b'));
+
+    database_t next;
+    next.open(store_fn);
+    REQUIRE(next.replay(journal_fn) == 1);
+    REQUIRE(next.r("/b", partial) == std::string(64, 'b'));
+    REQUIRE(!next.r("/nope", [](const auto &z) { return bool(z); }));
+
+    unlink(journal_fn.c_str());
+    unlink(store_fn);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "disjoint_sets.hh"
+
+#include <thread>
+#include <vector>
+
+TEST_CASE( "disjoint_sets", "pairs merge into clusters, singles left out" ) {
+    disjoint_sets_t sets{10};
+    sets.unite(1, 2);
+    sets.unite(7, 3);
+    sets.unite(2, 7);
+    sets.unite(5, 8);
+    sets.unite(8, 5);
+    sets.unite(4, 4);
+    sets.unite(42, 1);
+
+    REQUIRE(sets.find(3) == sets.find(1));
+    REQUIRE(sets.find(4) != sets.find(1));
+    const auto clusters = sets.clusters();
+    REQUIRE(clusters.size() == 2);
+    REQUIRE(clusters.front() == std::set<file_id_t>{1, 2, 3, 7});
+    REQUIRE(clusters.back() == std::set<file_id_t>{5, 8});
+}
+
+TEST_CASE( "disjoint_sets threads", "the same clusters with several threads uniting at once" ) {
+    // chains i, i + 100, i + 200, ... for i < 100, the links handed out round robin, last to first
+    constexpr file_id_t n{100'000}, chains{100};
+    disjoint_sets_t sets{n};
+    std::vector<std::thread> threads;
+    for (u_int t{}; t < 8; ++t) {
+        threads.emplace_back([&sets, t] {
+            for (file_id_t i = n - 1 - t; i >= chains; i -= 8) {
+                sets.unite(i, i - chains);
+                if (i < chains + 8) break;
+            }
+        });
+    }
+    for (auto &t: threads) t.join();
+
+    const auto clusters = sets.clusters();
+    REQUIRE(clusters.size() == chains);
+    for (const auto &cluster: clusters) {
+        REQUIRE(cluster.size() == n / chains);
+        for (const auto id: cluster) REQUIRE(id % chains == *cluster.begin());
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "disk_order.hh"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+TEST_CASE( "order_by_disk", "sorted per device, extents after inode-only files, devices taking turns" ) {
+    struct file_t {
+        int id;
+        disk_pos_t pos;
+    };
+    std::vector<file_t> files{
+            {0, {1, 50, 9000}},
+            {1, {2, 10, {}}},
+            {2, {1, 40, {}}},
+            {3, {1, 60, 100}},
+            {4, {2, 5, {}}},
+            {5, {1, 30, {}}},
+            {6, {1, 70, 500}},
+    };
+    const auto ordered = order_by_disk(std::move(files), [](const file_t &f) -> const disk_pos_t & { return f.pos; });
+
+    std::vector<int> ids;
+    for (const auto &f: ordered) ids.push_back(f.id);
+    // device 1: inodes 30, 40, then offsets 100, 500, 9000; device 2: inodes 5, 10, turns taken
+    REQUIRE(ids == std::vector<int>{5, 4, 2, 1, 3, 6, 0});
+}
+
+TEST_CASE( "disk_pos", "a file's device and inode, no extent for an empty one" ) {
+    char fn[] = "/tmp/imgproc_disk_order_XXXXXX";
+    const int fd = mkstemp(fn);
+    REQUIRE(fd >= 0);
+    struct stat st{};
+    REQUIRE(fstat(fd, &st) == 0);
+
+    const auto empty = disk_pos(fn, st);
+    REQUIRE(empty.dev == st.st_dev);
+    REQUIRE(empty.ino == st.st_ino);
+    REQUIRE(!empty.offset);
+
+    const std::string data(64 * 1024, 'x');
+    REQUIRE(write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+    fsync(fd);
+    REQUIRE(fstat(fd, &st) == 0);
+    const auto written = disk_pos(fn, st); // an extent wherever the filesystem has FIEMAP, tmpfs doesn't
+    REQUIRE(written.ino == st.st_ino);
+    if (written.offset) REQUIRE(written.key() > empty.key());
+
+    close(fd);
+    unlink(fn);
+}
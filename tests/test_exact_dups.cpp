@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "exact_dups.hh"
+
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// a sha256 as stored, two hex digits over and over standing in for the real thing
+std::string sha(const std::string &two) {
+    std::string ret;
+    for (int i{}; i < 32; ++i) ret += two;
+    return ret;
+}
+
+// file i's size and its partial and full hash
+struct files_t {
+    std::vector<std::tuple<off_t, std::string, std::string>> files;
+    std::map<std::pair<file_id_t, exact_dups_t::stage_t>, int> hashed;
+    std::mutex mtx;
+
+    exact_dups_t::hasher_t hasher() {
+        return [this](file_id_t id, exact_dups_t::stage_t stage) -> std::optional<std::string> {
+            std::lock_guard l{mtx};
+            ++hashed[{id, stage}];
+            const auto &h = stage == exact_dups_t::by_partial ? std::get<1>(files[id]) : std::get<2>(files[id]);
+            if (h.empty()) return {};
+            return sha(h);
+        };
+    }
+
+    std::optional<file_id_t> add(exact_dups_t &dups, file_id_t id) { return dups.add(id, {std::get<0>(files[id])}, hasher()); }
+};
+
+}
+
+TEST_CASE( "exact_dups", "sizes first, then the edges, then everything, each only as far as it takes" ) {
+    constexpr off_t big{1 << 20};
+    files_t f{.files{
+            {big, "aa", "a1"}, // 0
+            {big + 1, "aa", "a1"}, // 1, another size
+            {big, "bb", "b1"}, // 2, other edges
+            {big, "aa", "a2"}, // 3, same edges, differs in the middle
+            {big, "aa", "a1"}, // 4, copy of 0
+            {100, "cc", "cc"}, // 5, small, the edges are everything
+            {100, "cc", "cc"}, // 6, copy of 5
+            {big, "", ""}, // 7, unreadable
+    }};
+    exact_dups_t dups;
+    REQUIRE(!f.add(dups, 0));
+    REQUIRE(!f.add(dups, 1));
+    REQUIRE(f.hashed.empty()); // sizes nobody else has
+    REQUIRE(!f.add(dups, 2));
+    REQUIRE(f.hashed == std::map<std::pair<file_id_t, exact_dups_t::stage_t>, int>{{{0, exact_dups_t::by_partial}, 1}, {{2, exact_dups_t::by_partial}, 1}});
+    REQUIRE(!f.add(dups, 3));
+    REQUIRE(f.hashed[{0, exact_dups_t::by_full}] == 1);
+    REQUIRE(f.hashed[{3, exact_dups_t::by_full}] == 1);
+    REQUIRE(!f.hashed.contains({2, exact_dups_t::by_full}));
+    REQUIRE(f.add(dups, 4) == 0);
+    REQUIRE(f.hashed[{0, exact_dups_t::by_partial}] == 1); // what's worked out stays worked out
+    REQUIRE(f.hashed[{0, exact_dups_t::by_full}] == 1);
+    REQUIRE(!f.add(dups, 5));
+    REQUIRE(f.add(dups, 6) == 5);
+    REQUIRE(!f.hashed.contains({6, exact_dups_t::by_full}));
+    REQUIRE(!f.add(dups, 7));
+
+    // hashes known from the record aren't worked out again
+    f.files.emplace_back(big, "bb", "b1"); // 8, copy of 2
+    REQUIRE(dups.add(8, {big, sha("bb"), sha("b1")}, f.hasher()) == 2);
+    REQUIRE(!f.hashed.contains({8, exact_dups_t::by_partial}));
+    REQUIRE(!f.hashed.contains({8, exact_dups_t::by_full}));
+
+    REQUIRE(dups.copies() == 3);
+    REQUIRE(dups.groups() == std::list<std::set<file_id_t>>{{0, 4}, {2, 8}, {5, 6}});
+    const auto resolved = dups.resolved();
+    // 0 and 5 were alone in their size only until 2 and 6 came along
+    REQUIRE(resolved[exact_dups_t::by_size] == 1); // 1
+    REQUIRE(resolved[exact_dups_t::by_partial] == 4); // 0, 2, 5, 6
+    REQUIRE(resolved[exact_dups_t::by_full] == 3); // 3, 4, 8
+}
+
+TEST_CASE( "exact_dups threads", "one first per content whoever gets there" ) {
+    files_t f;
+    for (file_id_t i{}; i < 4000; ++i) f.files.emplace_back(1000000 + i % 20, std::string(1, "0123456789"[i % 10]) + "0", std::string(1, "0123456789"[i % 10]) + "1");
+    exact_dups_t dups;
+    std::vector<std::thread> threads;
+    for (file_id_t t{}; t < 4; ++t) {
+        threads.emplace_back([&dups, &f, t] {
+            for (file_id_t i{}; i < 1000; ++i) f.add(dups, t * 1000 + i);
+        });
+    }
+    for (auto &t: threads) t.join();
+    REQUIRE(dups.copies() == 4000 - 20);
+    REQUIRE(dups.groups().size() == 20);
+}
+
+TEST_CASE( "exact_dups algorithms", "hashes of different algorithms never match" ) {
+    constexpr off_t big{1 << 20};
+    const auto sha256 = content_hash(hash_algo_t::sha256, reinterpret_cast<const uint8_t *>("x"), 1);
+    const auto xxh64 = content_hash(hash_algo_t::xxh64, reinterpret_cast<const uint8_t *>("x"), 1);
+    const auto no_hashing = [](file_id_t, exact_dups_t::stage_t) -> std::optional<std::string> { return {}; };
+    exact_dups_t dups;
+    REQUIRE(!dups.add(0, {big, sha256, sha256}, no_hashing));
+    REQUIRE(!dups.add(1, {big, xxh64, xxh64}, no_hashing));
+    REQUIRE(dups.add(2, {big, xxh64, xxh64}, no_hashing) == 1);
+}
+
+TEST_CASE( "exact_dups full hashes", "files that all come with their full hash don't get read" ) {
+    constexpr off_t big{1 << 20};
+    files_t f{.files{{big, "aa", "a1"}, {big, "aa", "a1"}, {big, "aa", "a2"}}};
+    exact_dups_t dups;
+    REQUIRE(!dups.add(0, {big, {}, sha("a1")}, f.hasher()));
+    REQUIRE(dups.add(1, {big, {}, sha("a1")}, f.hasher()) == 0);
+    REQUIRE(!dups.add(2, {big, {}, sha("a2")}, f.hasher()));
+    REQUIRE(f.hashed.empty());
+    REQUIRE(dups.resolved()[exact_dups_t::by_full] == 3); // 0 along with 1, 2
+
+    // one without it gets the partials worked out as before
+    REQUIRE(dups.add(3, {big}, [](file_id_t id, exact_dups_t::stage_t stage) -> std::optional<std::string> {
+        return sha(stage == exact_dups_t::by_partial ? "aa" : id == 3 ? "a2" : "a1");
+    }) == 2);
+}
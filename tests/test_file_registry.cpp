@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "file_registry.hh"
+
+#include <set>
+#include <thread>
+#include <vector>
+
+TEST_CASE( "file_registry", "dense ids, paths come back as they went in, folders shared" ) {
+    file_registry_t files;
+    const std::vector<std::string> odd{"/", "/top.jpg", "relative/a.jpg", "bare.jpg", "/x//y/./z.png", "/home/photos/", ""};
+    for (size_t i{}; i < odd.size(); ++i) REQUIRE(files.add(odd[i]) == i);
+    for (size_t i{}; i < odd.size(); ++i) REQUIRE(files.path(i) == odd[i]);
+
+    const std::string prefix{"/home/photos/2019/some rather long folder name/"};
+    const auto first = files.size();
+    size_t names{};
+    for (int i{}; i < 1000; ++i) {
+        const auto name = "IMG_" + std::to_string(i) + ".jpg";
+        names += name.size();
+        REQUIRE(files.add(prefix + name) == first + i);
+    }
+    REQUIRE(files.size() == first + 1000);
+    REQUIRE(files.path(first + 567) == prefix + "IMG_567.jpg");
+    REQUIRE(files.arena_bytes() < names + 200);
+}
+
+TEST_CASE( "file_registry threads", "ids stay unique and paths right with several threads adding" ) {
+    file_registry_t files;
+    std::vector<std::vector<std::pair<file_id_t, std::string>>> added(8);
+    std::vector<std::thread> threads;
+    for (int t{}; t < 8; ++t) {
+        threads.emplace_back([&files, &added, t] {
+            for (int d{}; d < 50; ++d) {
+                for (int f{}; f < 50; ++f) {
+                    auto fn = "/r/d" + std::to_string(d % 10) + "/t" + std::to_string(t) + "/" + std::to_string(f);
+                    const auto id = files.add(fn);
+                    added[t].emplace_back(id, std::move(fn));
+                }
+            }
+        });
+    }
+    for (auto &t: threads) t.join();
+
+    std::set<file_id_t> ids;
+    for (const auto &list: added) {
+        for (const auto &[id, fn]: list) {
+            REQUIRE(files.path(id) == fn);
+            ids.emplace(id);
+        }
+    }
+    REQUIRE(ids.size() == 8 * 50 * 50);
+    REQUIRE(*ids.rbegin() == ids.size() - 1);
+    REQUIRE(files.dirs() == 1 + 1 + 10 + 10 * 8);
+}
+
+TEST_CASE( "file_registry unique", "a path added again keeps its id once asked to" ) {
+    file_registry_t files;
+    REQUIRE(files.add("/a/b.jpg") == 0);
+    REQUIRE(files.add("/a/b.jpg") == 1);
+    files.unique_paths();
+    REQUIRE(files.add("/a/b.jpg") == 0);
+    REQUIRE(files.add("/a/c.jpg") == 2);
+    REQUIRE(files.add("/a/c.jpg") == 2);
+    REQUIRE(files.add("/x/c.jpg") == 3);
+    REQUIRE(files.size() == 4);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "hamming_index.hh"
+
+#include <random>
+#include <set>
+#include <tuple>
+
+TEST_CASE( "hamming_index", "same pairs as all against all" ) {
+    std::mt19937_64 rnd{3};
+    std::vector<uint64_t> hashes;
+    for (int i{}; i < 400; ++i) {
+        const auto h = rnd();
+        hashes.push_back(h);
+        // and a few near copies of it
+        for (int n{}; n < 3; ++n) {
+            auto c = h;
+            for (int b = rnd() % 12; b > 0; --b) c ^= uint64_t{1} << (rnd() % 64);
+            hashes.push_back(c);
+        }
+    }
+    hashes.push_back(hashes.front()); // an exact one
+
+    const hamming_index_t index{hashes};
+    for (const u_int k: {0U, 1U, 3U, 4U, 7U, 10U}) {
+        std::set<std::tuple<uint32_t, uint32_t>> expected, found;
+        for (uint32_t i{}; i < hashes.size(); ++i) {
+            for (uint32_t j{i + 1}; j < hashes.size(); ++j) {
+                if (static_cast<u_int>(__builtin_popcountll(hashes[i] ^ hashes[j])) <= k) expected.emplace(i, j);
+            }
+        }
+        index.pairs_within(k, [&found](uint32_t i, uint32_t j, u_int) { CHECK(found.emplace(i, j).second); });
+        CHECK(found == expected);
+    }
+}
@@ -10,7 +10,15 @@
 
 #include <catch2/catch.hpp>
 
+#include "content_hash.hh"
 #include "point.hh"
+#include "xxh64.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
 
 TEST_CASE( "point_hash", "hash uniqueness" ) {
     std::unordered_map<size_t, int> hashes;
@@ -21,3 +29,48 @@ TEST_CASE( "point_hash", "hash uniqueness" ) {
         }
     }
 }
+
+TEST_CASE( "xxh64", "reference values, the same fed in pieces" ) {
+    const auto h = [](const char *s) { return xxh64_t::hash(s, strlen(s)); };
+    REQUIRE(h("") == 0xef46db3751d8e999ull);
+    REQUIRE(h("a") == 0xd24ec4f1a98c6e5bull);
+    REQUIRE(h("abc") == 0x44bc2cf5ad770999ull);
+    REQUIRE(h("Nobody inspects the spammish repetition") == 0xfbcea83c8a378bf1ull);
+
+    std::vector<uint8_t> data(100'000);
+    for (size_t i{}; i < data.size(); ++i) data[i] = i * 7 + 3;
+    xxh64_t pieces;
+    for (size_t i{}, n{1}; i < data.size(); i += n, n = n * 3 % 97 + 1) pieces.update(data.data() + i, std::min(n, data.size() - i));
+    REQUIRE(pieces.digest() == xxh64_t::hash(data.data(), data.size()));
+}
+
+TEST_CASE( "content_hash", "stored hashes name their algorithm, files hash the same as their bytes" ) {
+    const auto *abc = reinterpret_cast<const uint8_t *>("abc");
+    const auto sha256 = content_hash(hash_algo_t::sha256, abc, 3);
+    const auto xxh64 = content_hash(hash_algo_t::xxh64, abc, 3);
+    REQUIRE(sha256 == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    REQUIRE(xxh64 == "xxh64:44bc2cf5ad770999");
+    REQUIRE(stored_algo(sha256) == hash_algo_t::sha256);
+    REQUIRE(stored_algo(xxh64) == hash_algo_t::xxh64);
+    REQUIRE(format_hash(parse_hash(sha256)) == sha256);
+    REQUIRE(format_hash(parse_hash(xxh64)) == xxh64);
+    REQUIRE(parse_hash(sha256) != parse_hash(xxh64));
+    REQUIRE(!parse_hash("xxh64:44bc"));
+    REQUIRE(!parse_hash("md5:44bc2cf5ad770999"));
+    REQUIRE(hash_algo("xxh64") == hash_algo_t::xxh64);
+    REQUIRE(!hash_algo("md5"));
+
+    std::vector<uint8_t> data(300'000);
+    for (size_t i{}; i < data.size(); ++i) data[i] = i * 13 + 1;
+    char fn[] = "/tmp/imgproc_hash_XXXXXX";
+    const int fd = mkstemp(fn);
+    REQUIRE(write(fd, data.data(), data.size()) == ssize_t(data.size()));
+    close(fd);
+    for (const auto algo: {hash_algo_t::sha256, hash_algo_t::xxh64}) {
+        REQUIRE(file_hash(algo, fn) == content_hash(algo, data.data(), data.size()));
+        REQUIRE(edge_hash(algo, fn, 1000) == edge_hash(algo, data.data(), data.size(), 1000));
+        REQUIRE(edge_hash(algo, fn, 1000) != content_hash(algo, data.data(), data.size()));
+        REQUIRE(edge_hash(algo, fn, 200'000) == content_hash(algo, data.data(), data.size())); // the edges overlap
+    }
+    unlink(fn);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "inverted_index.hh"
+
+#include <map>
+#include <random>
+#include <set>
+
+TEST_CASE( "inverted_index", "parts merged into the same postings a map would have" ) {
+    std::mt19937 rng{7};
+    std::map<uint64_t, std::set<file_id_t>> expected;
+    std::vector<inverted_index_t::builder_t> parts(5);
+    for (file_id_t id{}; id < 2000; ++id) {
+        auto &part = parts[id % parts.size()];
+        for (u_int y{}; y < 3; ++y) {
+            for (u_int x{}; x < 3; ++x) {
+                const auto key = cell_key({x, y}, {int(rng() % 8), int(rng() % 8), int(rng() % 2)});
+                part.add(key, id);
+                expected[key].emplace(id);
+            }
+        }
+    }
+    for (auto &part: parts) part.finish();
+
+    const inverted_index_t index{std::move(parts)};
+    REQUIRE(index.keys() == expected.size());
+    REQUIRE(index.postings() == 2000 * 9);
+    for (const auto &[key, ids]: expected) {
+        const auto found = index.find(key);
+        REQUIRE(std::vector<file_id_t>(found.begin(), found.end()) == std::vector<file_id_t>(ids.begin(), ids.end()));
+    }
+    REQUIRE(index.find(cell_key({5, 5}, {0, 0, 0})).empty());
+    REQUIRE(cell_key({1, 2}, {3, 4, 5}) != cell_key({2, 1}, {3, 4, 5}));
+    REQUIRE(inverted_index_t{}.find(0).empty());
+}
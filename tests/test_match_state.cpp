@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "match_state.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+TEST_CASE( "match_state", "the state comes back from its file, stored files match while live" ) {
+    char fn[] = "/tmp/imgproc_index_XXXXXX";
+    close(mkstemp(fn));
+    unlink(fn);
+    REQUIRE(!match_state_t::load(fn));
+
+    // 2x2 grids, 0 and 1 black, 2 white
+    const std::vector<int> colors{0, 0, 255};
+    match_state_t state;
+    state.grid = {2, 2};
+    state.px_n = 1;
+    state.px_d = 32;
+    state.paths = {"/a/0.jpg", "/a/1.jpg", "/b/2.jpg"};
+    state.cells = cell_vals_t{colors.size(), state.grid};
+    std::vector<inverted_index_t::builder_t> parts(1);
+    for (file_id_t id{}; id < colors.size(); ++id) {
+        const px_t px{colors[id], colors[id], colors[id]};
+        for (u_int i{}; i < 4; ++i) {
+            state.cells.set(id, {i % 2, i / 2}, px);
+            parts[0].add(cell_key({i % 2, i / 2}, px_t::mult<0, 1, 32>(px)), id);
+        }
+    }
+    parts[0].finish();
+    state.index = inverted_index_t{std::move(parts)};
+    state.clusters = {{0, 1}};
+    state.save(fn);
+
+    const auto loaded = match_state_t::load(fn);
+    REQUIRE(loaded);
+    REQUIRE(loaded->grid == state.grid);
+    REQUIRE(loaded->px_d == 32);
+    REQUIRE(loaded->paths == state.paths);
+    REQUIRE(loaded->clusters == state.clusters);
+    REQUIRE(loaded->index.keys() == state.index.keys());
+    REQUIRE(loaded->index.postings() == state.index.postings());
+    for (file_id_t id{}; id < colors.size(); ++id) REQUIRE(std::memcmp(loaded->cells.get(id), state.cells.get(id), 4 * 3) == 0);
+
+    // file 3 is new and black, it finds the stored black ones that are still as they were
+    std::vector<inverted_index_t::builder_t> fresh(1);
+    std::vector<uint64_t> keys;
+    for (u_int i{}; i < 4; ++i) {
+        keys.push_back(cell_key({i % 2, i / 2}, {0, 0, 0}));
+        fresh[0].add(keys.back(), 3);
+    }
+    fresh[0].finish();
+    const inverted_index_t index{std::move(fresh)};
+    std::vector<std::atomic<bool>> live(colors.size());
+    live[0] = true;
+    live[2] = true;
+    matcher_t matcher{index, 4, 3, true};
+    matcher.add_stored(loaded->index, live);
+    std::vector<file_id_t> out;
+    matcher.match(3, keys, out);
+    REQUIRE(out == std::vector<file_id_t>{0});
+
+    // a damaged file throws
+    REQUIRE(truncate(fn, 40) == 0);
+    REQUIRE_THROWS(match_state_t::load(fn));
+    unlink(fn);
+}
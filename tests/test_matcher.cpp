@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "matcher.hh"
+
+#include <algorithm>
+#include <set>
+
+namespace {
+
+// 3x3 grids, file i has cell (x, y) colored by colors[i][y * 3 + x]
+std::vector<std::vector<uint64_t>> file_keys(const std::vector<std::vector<int>> &colors) {
+    std::vector<std::vector<uint64_t>> ret;
+    for (const auto &cells: colors) {
+        auto &keys = ret.emplace_back();
+        for (u_int i{}; i < 9; ++i) keys.push_back(cell_key({i % 3, i / 3}, {cells[i], cells[i], cells[i]}));
+    }
+    return ret;
+}
+
+}
+
+TEST_CASE( "matcher", "files sharing enough cells, each pair once when symmetric" ) {
+    const auto keys = file_keys({
+            {0, 0, 0, 0, 0, 0, 0, 0, 0}, // 0, 1 and 2 all black, 2 differs in one cell
+            {0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 7},
+            {1, 2, 3, 4, 5, 6, 7, 1, 2}, // 3 and 4 share 6 cells
+            {1, 2, 3, 4, 5, 6, 0, 0, 0},
+    });
+    std::vector<inverted_index_t::builder_t> parts(1);
+    for (file_id_t id{}; id < keys.size(); ++id) {
+        for (const auto key: keys[id]) parts[0].add(key, id);
+    }
+    parts[0].finish();
+    const inverted_index_t index{std::move(parts)};
+
+    std::vector<file_id_t> out;
+    matcher_t both{index, keys.size(), 8, false};
+    std::set<std::pair<file_id_t, file_id_t>> pairs;
+    for (file_id_t id{}; id < keys.size(); ++id) {
+        both.match(id, keys[id], out);
+        for (const auto mid: out) pairs.emplace(id, mid);
+    }
+    REQUIRE(pairs == std::set<std::pair<file_id_t, file_id_t>>{{0, 1}, {0, 2}, {1, 0}, {1, 2}, {2, 0}, {2, 1}});
+    REQUIRE(both.stats().matches == 6);
+
+    matcher_t once{index, keys.size(), 6, true};
+    pairs.clear();
+    for (file_id_t id{}; id < keys.size(); ++id) {
+        once.match(id, keys[id], out);
+        for (const auto mid: out) pairs.emplace(id, mid);
+    }
+    REQUIRE(pairs == std::set<std::pair<file_id_t, file_id_t>>{{0, 1}, {0, 2}, {1, 2}, {3, 4}});
+
+    const auto largest = matcher_t::largest_postings(index, 2);
+    REQUIRE(largest.size() == 2);
+    REQUIRE(largest[0].second == 4); // cells (0, 2) and (1, 2), black in 0, 1, 2 and 4
+    REQUIRE(largest[1].second == 4);
+}
+
+TEST_CASE( "matcher tolerant", "neighboring buckets probed, the full colors confirm" ) {
+    // 0 and 1 straddle the 95/96 bucket edge everywhere, 2 is at the far end of 1's bucket
+    const std::vector<int> colors{95, 96, 127};
+    std::vector<inverted_index_t::builder_t> parts(1);
+    cell_vals_t vals{colors.size(), {3, 3}};
+    for (file_id_t id{}; id < colors.size(); ++id) {
+        const px_t px{colors[id], colors[id], colors[id]};
+        for (u_int i{}; i < 9; ++i) {
+            parts[0].add(cell_key({i % 3, i / 3}, px_t::mult<0, 1, 32>(px)), id);
+            vals.set(id, {i % 3, i / 3}, px);
+        }
+    }
+    parts[0].finish();
+    const inverted_index_t index{std::move(parts)};
+    matcher_t matcher{index, colors.size(), 8, false};
+
+    const auto match = [&](file_id_t id, int tolerance) {
+        std::vector<uint64_t> keys;
+        const px_t px{colors[id], colors[id], colors[id]};
+        for (u_int i{}; i < 9; ++i) {
+            if (tolerance) probe_keys<1, 32>({i % 3, i / 3}, px, tolerance, keys);
+            else keys.push_back(cell_key({i % 3, i / 3}, px_t::mult<0, 1, 32>(px)));
+        }
+        std::vector<file_id_t> out;
+        matcher.match(id, keys, out);
+        std::erase_if(out, [&](file_id_t mid) { return vals.agreeing<1, 32>(id, mid, tolerance) < 8; });
+        std::sort(out.begin(), out.end());
+        return out;
+    };
+    REQUIRE(match(0, 0).empty());
+    REQUIRE(match(0, 2) == std::vector<file_id_t>{1});
+    REQUIRE(match(1, 2) == std::vector<file_id_t>{0, 2});
+    // 1 and 2 share the bucket, exact matching has them, tolerance keeps them
+    REQUIRE(match(2, 0) == std::vector<file_id_t>{1});
+    REQUIRE(match(2, 2) == std::vector<file_id_t>{1});
+
+    std::vector<uint64_t> keys;
+    probe_keys<1, 32>({0, 0}, {100, 95, 255}, 4, keys);
+    REQUIRE(keys.size() == 2); // only green is near an edge, 255 has no bucket above
+}
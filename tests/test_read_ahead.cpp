@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "globals.hh"
+#include "uring_reader.hh"
+#include "worker_thread.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// a temp folder with files of these contents, gone with it
+struct tmp_files_t {
+    explicit tmp_files_t(const std::vector<std::string> &contents) {
+        char tmpl[] = "/tmp/imgproc_read_XXXXXX";
+        REQUIRE(mkdtemp(tmpl));
+        root = tmpl;
+        for (size_t i{}; i < contents.size(); ++i) {
+            paths.push_back((root / ("f" + std::to_string(i))).string());
+            std::ofstream{paths.back(), std::ios::binary} << contents[i];
+        }
+    }
+    ~tmp_files_t() { fs::remove_all(root); }
+
+    fs::path root;
+    std::vector<std::string> paths;
+};
+
+std::string pattern(size_t n) {
+    std::string ret(n, '\0');
+    for (size_t i{}; i < n; ++i) ret[i] = static_cast<char>(i * 7 + i / 251);
+    return ret;
+}
+
+}
+
+TEST_CASE( "uring_reader", "whole files in any order, chunked, empty and missing ones" ) {
+    auto reader = uring_reader_t::open(4);
+    if (!reader) {
+        WARN("no io_uring in this build or kernel");
+        return;
+    }
+    const std::vector<std::string> contents{pattern(100), "", pattern(uring_reader_t::CHUNK * 2 + 12345), pattern(uring_reader_t::CHUNK)};
+    tmp_files_t files{contents};
+    files.paths.push_back((files.root / "missing").string());
+
+    std::map<uint64_t, std::optional<std::string>> got;
+    const auto done = [&got](uint64_t tag, std::optional<gvs::dynbuf<uint8_t>> &&bytes, std::chrono::microseconds) {
+        REQUIRE(!got.contains(tag));
+        got[tag] = bytes ? std::optional<std::string>{std::string(reinterpret_cast<const char *>(bytes->data()), bytes->size())} : std::nullopt;
+    };
+    // one more file than the depth, so one waits for a slot
+    for (uint64_t tag{}; tag < files.paths.size(); ++tag) {
+        while (reader->full()) reader->reap(true, done);
+        reader->submit(tag, files.paths[tag]);
+    }
+    while (reader->in_flight() > 0) reader->reap(true, done);
+
+    REQUIRE(got.size() == files.paths.size());
+    for (size_t i{}; i < contents.size(); ++i) {
+        REQUIRE(got[i]);
+        REQUIRE(*got[i] == contents[i]);
+    }
+    REQUIRE(!got[contents.size()]);
+    REQUIRE(reader->abandon().empty());
+}
+
+TEST_CASE( "read_stage", "every file queued reaches the decoders, read unless it's stored and wasn't touched" ) {
+    const std::vector<std::string> contents{pattern(10), pattern(5000), "", pattern(70000)};
+    tmp_files_t files{contents};
+    files.paths.push_back((files.root / "missing").string());
+    std::vector<file_id_t> ids;
+    for (const auto &fn: files.paths) ids.push_back(g::files.add(fn));
+
+    // the blocking readers, and the io_uring one where there is io_uring
+    auto ring = uring_reader_t::open(2);
+    for (const bool uring: {false, true}) {
+        if (uring && !ring) continue;
+        constexpr int readers{3};
+        g::extract_queue.producers(1);
+        g::read_queue.producers(uring ? 1 : readers);
+        std::vector<std::thread> threads;
+        if (uring) threads.emplace_back([&ring] { uring_read_stage(*ring); });
+        else for (int i{}; i < readers; ++i) threads.emplace_back(read_stage);
+        std::thread feeder{[&ids] {
+            // the last one of the contents is stored but touched, its record gets checked against its bytes
+            for (const auto id: ids) {
+                g::extract_queue.push({id, id == ids[1] || id == ids[3], id == ids[3] ? std::optional<g::stated_t>{{id, {}, 70000}} : std::nullopt});
+            }
+            g::extract_queue.done();
+        }};
+
+        std::map<file_id_t, g::read_t> got;
+        while (auto file = g::read_queue.pop()) {
+            const auto id = file->id;
+            REQUIRE(got.emplace(id, std::move(*file)).second);
+        }
+        feeder.join();
+        for (auto &t: threads) t.join();
+
+        REQUIRE(got.size() == ids.size());
+        for (size_t i{}; i < contents.size(); ++i) {
+            const auto &file = got.at(ids[i]);
+            REQUIRE(file.stored == (i == 1 || i == 3));
+            REQUIRE(bool(file.touched) == (i == 3));
+            if (file.touched) REQUIRE(file.touched->size == 70000);
+            if (i == 1) {
+                REQUIRE(!file.buf);
+                continue;
+            }
+            REQUIRE(file.buf);
+            REQUIRE(std::string(reinterpret_cast<const char *>(file.buf->data()), file.buf->size()) == contents[i]);
+        }
+        REQUIRE(!got.at(ids.back()).buf);
+    }
+}
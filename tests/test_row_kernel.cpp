@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "bmp_averager.hh"
+#include "grid.hh"
+#include "grid_accumulator.hh"
+#include "row_kernel.hh"
+
+#include <random>
+#include <vector>
+
+TEST_CASE( "row_sum", "simd kernels match scalar" ) {
+    std::mt19937 rnd{42};
+    std::vector<uint8_t> data(3 * 1000 + 7);
+    for (auto &b: data) b = rnd();
+
+    for (const u_int pxs: {1U, 3U}) {
+        const auto scalar = get_row_sum(pxs, simd_t::scalar);
+        for (const auto simd: {simd_t::sse2, simd_t::avx2}) {
+            const auto fn = get_row_sum(pxs, simd);
+            for (u_int off{}; off < 5; ++off) {
+                for (u_int n{}; n < 300; n += 7) {
+                    uint64_t a[3]{}, b[3]{};
+                    scalar(data.data() + off, n, a);
+                    fn(data.data() + off, n, b);
+                    CHECK(a[0] == b[0]);
+                    CHECK(a[1] == b[1]);
+                    CHECK(a[2] == b[2]);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE( "grid_accumulator", "same averages as per pixel averaging" ) {
+    std::mt19937 rnd{7};
+    // specialized sizes and one that takes the dynamic accumulator
+    for (const auto &[gw, gh]: {std::make_tuple(3U, 3U), std::make_tuple(16U, 8U), std::make_tuple(5U, 7U)}) {
+        for (const u_int pxs: {1U, 3U}) {
+            const u_int w{641}, h{359};
+            std::vector<uint8_t> img(w * h * pxs);
+            for (auto &b: img) b = rnd();
+
+            bmp_averager_t ref;
+            grid_t gridder{gw, gh, w, h};
+            for (u_int y{}; y < h; ++y) {
+                for (u_int x{}; x < w; ++x) ref.val(gridder({x, y})) += px_t{img.data() + (y * w + x) * pxs, pxs};
+            }
+
+            grid_accumulator_t acc{{point_t{gw, gh}}};
+            acc.begin(w, h, pxs);
+            acc.rows(0, img.data(), h, w * pxs);
+            const auto avgs = acc.avgs().at({gw, gh});
+
+            REQUIRE(avgs.size() == ref.vals().size());
+            for (const auto &[p, val]: ref.vals()) CHECK(avgs.at(p) == val());
+        }
+    }
+}
+
+TEST_CASE( "multigrid", "one shared pass gives the same grids as separate ones" ) {
+    std::mt19937 rnd{11};
+    const u_int w{1023}, h{677};
+    std::vector<uint8_t> img(w * h * 3);
+    for (auto &b: img) b = rnd();
+
+    for (const auto &grids: {std::vector<point_t>{{3, 3}, {8, 8}, {16, 16}}, std::vector<point_t>{{3, 3}, {7, 5}, {64, 64}}}) {
+        grid_accumulator_t acc{grids};
+        acc.begin(w, h, 3);
+        acc.rows(0, img.data(), h, w * 3);
+        const auto all = acc.avgs();
+        REQUIRE(all.size() == grids.size());
+
+        for (const auto &gr: grids) {
+            grid_accumulator_t one{std::vector<point_t>{gr}};
+            one.begin(w, h, 3);
+            one.rows(0, img.data(), h, w * 3);
+            const auto &avgs = all.at(gr);
+            const auto ref = one.avgs().at(gr);
+            REQUIRE(avgs.size() == ref.size());
+            for (const auto &[p, val]: ref) CHECK(avgs.at(p) == val);
+        }
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2019+ Gene Savchuk as an unpublished work.
+ * All rights reserved.
+ *
+ * The information contained herein is confidential property of
+ * Gene Savchuk. The use, copying, transfer or disclosure of such
+ * information is prohibited except by express written agreement with
+ * Gene Savchuk.
+ */
+
+#include <catch2/catch.hpp>
+
+#include "scanner.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+
+TEST_CASE( "scan_tree", "every file once, hardlinks and overlapping roots skipped" ) {
+    namespace fs = std::filesystem;
+    char tmpl[] = "/tmp/imgproc_scan_XXXXXX";
+    REQUIRE(mkdtemp(tmpl));
+    const fs::path root{tmpl};
+
+    std::set<std::string> expected;
+    for (int d{}; d < 20; ++d) {
+        auto dir = root / ("d" + std::to_string(d)) / "sub";
+        fs::create_directories(dir);
+        for (int f{}; f < 30; ++f) {
+            const auto fn = dir / ("f" + std::to_string(f));
+            std::ofstream{fn} << f;
+            expected.emplace(fn.string());
+        }
+    }
+    fs::create_hard_link(root / "d0" / "sub" / "f0", root / "d1" / "link");
+    fs::create_symlink(root / "d0", root / "d2" / "symlink");
+
+    // assertions only back on this thread, the callback runs on the scanner's threads
+    std::mutex mtx;
+    std::set<std::string> found;
+    size_t twice{};
+    const auto stats = scan_tree({root.string(), (root / "d3").string(), root.string() + "/"}, 4, [&mtx, &found, &twice](std::string &&fn) {
+        std::lock_guard lock{mtx};
+        if (!found.emplace(std::move(fn)).second) ++twice;
+    });
+    fs::remove_all(root);
+
+    REQUIRE(twice == 0);
+    REQUIRE(stats.files == expected.size());
+    REQUIRE(stats.duplicates == 1);
+    REQUIRE(stats.errors == 0);
+    // the hardlink is found under one of its names
+    if (found.contains((root / "d1" / "link").string())) {
+        found.erase((root / "d1" / "link").string());
+        found.emplace((root / "d0" / "sub" / "f0").string());
+    }
+    REQUIRE(found == expected);
+}